@@ -0,0 +1,46 @@
+#pragma once
+#include <stdlib.h>
+
+#include "macros.h"
+#include "types.h"
+
+// Heap entry points for the game. Debug builds count every allocation so
+// paths that must stay off the heap can assert it. The count is per thread,
+// a path only asserts on its own allocations.
+extern _Thread_local usize alloc_count;
+
+#ifdef DEBUG
+#define ALLOC(_n) (alloc_count++, malloc(_n))
+#define CALLOC(_c, _n) (alloc_count++, calloc(_c, _n))
+#define REALLOC(_p, _n) (alloc_count++, realloc(_p, _n))
+
+#define ALLOC_CHECKPOINT(_name) usize _name = alloc_count
+#define ASSERT_NO_ALLOC_SINCE(_name) ASSERT(alloc_count == _name, "%zu allocations on a path that must not allocate\n", alloc_count - _name)
+#else
+#define ALLOC(_n) malloc(_n)
+#define CALLOC(_c, _n) calloc(_c, _n)
+#define REALLOC(_p, _n) realloc(_p, _n)
+
+#define ALLOC_CHECKPOINT(_name)
+#define ASSERT_NO_ALLOC_SINCE(_name)
+#endif
+
+// Bump allocator over one block, for scratch memory that is dropped all at
+// once. Allocations are ARENA_ALIGN aligned.
+#define ARENA_ALIGN 16
+
+struct arena {
+    u8 *base;
+    usize size;
+    usize used;
+};
+
+void arena_init(struct arena *a, usize size);
+
+// NULL once the block is used up
+void *arena_alloc(struct arena *a, usize n);
+
+// drop everything allocated so far
+void arena_reset(struct arena *a);
+
+void arena_destroy(struct arena *a);
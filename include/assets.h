@@ -0,0 +1,59 @@
+#pragma once
+#include "sprite.h"
+#include "types.h"
+
+// Every image the game draws, in sheet order: the 26 letter tiles then the
+// queue border.
+#define ASSET_TILE(_letter) ((_letter) - 'A')
+#define ASSET_QUEUE_BORDER 26
+#define ASSET_COUNT 27
+
+extern const char *asset_files[ASSET_COUNT];
+
+#define ASSET_SHEET_MAGIC 0x54485347 // "GSHT" in a little endian file
+#define ASSET_SHEET_VERSION 2
+
+struct asset_sheet_entry {
+    u32 width, height;
+    u32 offset; // in pixels from the start of the pixel block
+    u64 source_size;
+    i64 source_mtime;
+};
+
+// Header of a packed sprite sheet. The ABGR8888 pixels of every asset follow
+// it back to back, so the file can be mapped and drawn from in place. The
+// source fields detect a stale sheet.
+struct asset_sheet_header {
+    u32 magic;
+    u32 version;
+    u32 count;
+    u32 pixel_count;
+    struct asset_sheet_entry entries[ASSET_COUNT];
+};
+
+struct assets {
+    sprite sprites[ASSET_COUNT];
+
+    // one block holding every sprite's pixels
+    u32 *pixels;
+    u32 pixel_count;
+
+    // set when the pixels live in a mapped sheet instead of the heap
+    void *map;
+    usize map_size;
+};
+
+// decode asset_files into one ABGR8888 block, returns -1 if any fails to load
+int assets_decode(struct assets *assets);
+
+// map a packed sheet, returns -1 if it is missing, malformed or older than
+// the images it was packed from
+int assets_load_sheet(struct assets *assets, const char *sheet_file);
+
+// write the decoded assets as a sheet that assets_load_sheet can map
+int assets_write_sheet(struct assets *assets, const char *sheet_file);
+
+// map the sheet, falling back to decoding the images
+int assets_load(struct assets *assets, const char *sheet_file);
+
+void assets_destroy(struct assets *assets);
@@ -0,0 +1,111 @@
+#pragma once
+#include "macros.h"
+#include "rng.h"
+#include "tile.h"
+#include "trie.h"
+#include "types.h"
+
+// Compact board core. Occupancy, grey, marked and connection state are kept as
+// one bitmask per row (bit x = column x) and letters as a separate byte array,
+// so physics and collision checks are a few shifts and ANDs per row.
+struct board {
+    u32 width, height;
+
+    u64 filled[GRID_MAX_DIM];
+    u64 greyed[GRID_MAX_DIM];
+    u64 marked[GRID_MAX_DIM];
+
+    // one mask per CON_* direction, a set bit means the tile is joined that way
+    u64 con_up[GRID_MAX_DIM];
+    u64 con_down[GRID_MAX_DIM];
+    u64 con_left[GRID_MAX_DIM];
+    u64 con_right[GRID_MAX_DIM];
+
+    u8 letters[GRID_MAX_DIM * GRID_MAX_DIM];
+
+    // rows and columns changed since they were last scanned, bit i = line i
+    u64 dirty_rows;
+    u64 dirty_cols;
+
+    // length of each word the last scan marked, columns first
+    u8 found[2 * GRID_MAX_DIM];
+    u32 found_count;
+
+    // Zobrist hash of every tile: the XOR of board_zobrist() over the filled
+    // cells, kept up to date by every function below that changes a tile
+    u64 hash;
+};
+
+void board_init(struct board *b, u32 width, u32 height);
+
+// copy the rows and letters src uses, a fraction of the struct on a small
+// board. The rest of dst is left as it was and never read.
+void board_copy(struct board *dst, const struct board *src);
+
+// Zobrist key of a tile, from a mix of its cell, letter, grey and CON_*
+// connection rather than a table, as there are too many combinations to store
+static inline u64 board_zobrist(int x, int y, u8 letter, bool greyed, u8 connected) {
+    return rng_mix(((u64)(y * GRID_MAX_DIM + x) << 16 | (u64)letter << 8 | (u64)greyed << 4 | connected) + 0x9e3779b97f4a7c15ull);
+}
+
+// hash from scratch, what the kept up hash must always equal
+u64 board_compute_hash(const struct board *b);
+
+// cells outside the board count as filled, so they double as walls
+static inline bool board_filled(const struct board *b, int x, int y) {
+    if (x < 0 || y < 0 || x >= b->width || y >= b->height) {
+        return true;
+    }
+    return (b->filled[y] >> x) & 1;
+}
+
+static inline u8 board_letter(const struct board *b, int x, int y) {
+    return b->letters[y * b->width + x];
+}
+
+static inline bool board_greyed(const struct board *b, int x, int y) {
+    return (b->greyed[y] >> x) & 1;
+}
+
+static inline bool board_marked(const struct board *b, int x, int y) {
+    return (b->marked[y] >> x) & 1;
+}
+
+// CON_* direction the tile at (x, y) is joined to its partner in
+u8 board_connection(const struct board *b, int x, int y);
+
+// place a tile, replacing whatever was in the cell
+void board_set(struct board *b, int x, int y, u8 letter, bool greyed, u8 connected);
+
+void board_clear_cell(struct board *b, int x, int y);
+
+// true if any of the columns in mask are occupied on row y
+static inline bool board_row_blocked(const struct board *b, int y, u64 mask) {
+    return (b->filled[y] & mask) != 0;
+}
+
+// drop connections whose partner no longer points back, true if any changed
+bool board_update_connections(struct board *b);
+
+// move every unsupported tile down one row, true if anything moved
+bool board_fall_step(struct board *b);
+
+// drop every unsupported tile straight to where it comes to rest, in one pass.
+// If drop is not NULL it receives, per cell, how many rows its tile fell.
+bool board_settle(struct board *b, u8 *drop);
+
+// mark the longest word in every dirty row and column, true if any were found.
+// cache is the scanning thread's own, or NULL
+bool board_scan_for_words(struct board *b, struct dict_trie *dict, struct line_cache *cache);
+
+// true if any of the rows and columns set in the masks holds a word, what a
+// scan with those lines dirty would find without marking anything
+bool board_lines_hold_word(const struct board *b, struct dict_trie *dict, struct line_cache *cache, u64 rows, u64 cols);
+
+// true if the run of tiles through the filled cell (x, y), along its column
+// or its row, holds a word. A word that wasn't on the line before (x, y) was
+// set runs through it, so on a scanned line this is whether it holds one now.
+bool board_run_holds_word(const struct board *b, struct dict_trie *dict, struct line_cache *cache, int x, int y, bool column);
+
+// empty all marked cells, true if any were cleared
+bool board_clear_marked(struct board *b);
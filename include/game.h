@@ -0,0 +1,115 @@
+#pragma once
+#include "board.h"
+#include "lpool.h"
+#include "rng.h"
+#include "trie.h"
+#include "types.h"
+#include "vec.h"
+
+// Game rules with no SDL dependency: the board, the falling pair, the queue,
+// scanning and physics, advanced through an explicit step API so the same
+// simulation runs in the windowed game and in headless tools.
+
+enum game_status {
+    QUIT,
+    HALT,
+    PAUSED,
+    GAMEOVER,
+    CLEARING,
+    PLAYING,
+    SCANNING,
+};
+
+// GRAVITY_SETTLE drops tiles to rest in one update instead of a row per tick
+enum game_gravity {
+    GRAVITY_STEP,
+    GRAVITY_SETTLE,
+};
+
+// set in game.events when the falling pair lands on the board
+#define GAME_EVENT_SET (1u << 0)
+
+// a tile that is not on the board yet, the falling pair and the queue preview
+struct game_tile {
+    u8 letter;
+    u8 connected;
+    vec2i pos;
+};
+
+struct game {
+    struct board board;
+    struct dict_trie *dict; // shared, only read once compacted
+    // Optional, set after game_init. Scans look lines up here first. It
+    // belongs to the thread running game_update, unlike the dictionary.
+    struct line_cache *lines;
+    struct letter_pool letter_pool;
+
+    // every random draw of the game comes from here, seeded by game_init
+    u64 seed;
+    struct rng rng;
+
+    enum game_status status;
+    enum game_gravity gravity;
+
+    struct {
+        bool active;
+        struct game_tile t1, t2;
+    } player;
+
+    // next pair to spawn
+    struct game_tile queue[2];
+
+    // simulation clock in ms: when the last update ran and the current tick length
+    double time;
+    double tick;
+
+    // rows each cell's tile fell in the last settle, which ran at `time`
+    u8 fall[GRID_MAX_DIM * GRID_MAX_DIM];
+
+    // GAME_EVENT_* bits, cleared by whoever consumes them
+    u32 events;
+};
+
+// start a game, the same seed always deals the same letters and grey tiles
+void game_init(struct game *g, struct dict_trie *dict, u32 cols, u32 rows, u64 seed);
+
+void game_destroy(struct game *g);
+
+// run one simulation update regardless of the clock
+void game_update(struct game *g);
+
+// length of the current tick in ms, depends on the status
+double game_tick_length(const struct game *g);
+
+// advance the clock to now (ms) and update if a tick elapsed, true if it did
+bool game_step(struct game *g, double now);
+
+// true if the falling pair can move by `move` without leaving the board or overlapping
+bool game_player_can_move(const struct game *g, vec2i move);
+
+// The rules for moving a pair, on any board. The game_player_* moves apply
+// them to the falling pair, the search (search.h) to pairs it tries out.
+
+// true if t1, t2 can move by `move` on b
+bool game_pair_can_move(const struct board *b, const struct game_tile *t1, const struct game_tile *t2, vec2i move);
+
+// rotate t1, t2 a quarter turn on b, kicked a column sideways if the turn is
+// blocked, false and unchanged if it can't turn
+bool game_pair_rotate_cw(const struct board *b, struct game_tile *t1, struct game_tile *t2);
+bool game_pair_rotate_ccw(const struct board *b, struct game_tile *t1, struct game_tile *t2);
+
+// place t1, t2 side by side at the top middle of b, false if that is blocked
+bool game_pair_spawn(const struct board *b, struct game_tile *t1, struct game_tile *t2);
+
+// shift the falling pair sideways by dx columns if there is room
+void game_player_shift(struct game *g, int dx);
+
+// move the falling pair down a row at time now (ms), landing it if it can't
+void game_player_drop(struct game *g, double now);
+
+void game_player_rotate_cw(struct game *g);
+
+void game_player_rotate_ccw(struct game *g);
+
+// swap the letters of the falling pair
+void game_player_flip(struct game *g);
@@ -1,23 +1,35 @@
 #pragma once
+#include "rng.h"
+#include "types.h"
 
-struct letter_node {
-    char letter;
-    int weight;
-    struct letter_node* next;
-};
+#define LPOOL_MAX_LETTERS 26
 
+// Weighted letter distribution. Letters and weights live in flat arrays and
+// draws go through a Walker/Vose alias table, rebuilt lazily after the weights
+// change: pick a column uniformly, then keep it or take its alias.
 struct letter_pool {
-    struct letter_node* head;
+    char letters[LPOOL_MAX_LETTERS];
+    int weights[LPOOL_MAX_LETTERS];
+    u32 count;
     int totalWeight;
+
+    // column i keeps letters[i] when a draw below totalWeight is under prob[i]
+    u32 prob[LPOOL_MAX_LETTERS];
+    u8 alias[LPOOL_MAX_LETTERS];
+    bool dirty;
 };
 
 void lpool_init(struct letter_pool* pool);
 
 void lpool_populate(struct letter_pool* pool);
 
+// add a letter, or replace its weight if it is already in the pool
 void lpool_add_letter(struct letter_pool* pool, char letter, int weight);
 
-char lpool_random_letter(struct letter_pool* pool);
+// draw a letter with probability proportional to its weight
+char lpool_random_letter(struct letter_pool* pool, struct rng* rng);
 
-void lpool_destroy(struct letter_pool* pool);
+// draw count letters into out
+void lpool_fill(struct letter_pool* pool, struct rng* rng, char* out, usize count);
 
+void lpool_destroy(struct letter_pool* pool);
@@ -1,9 +1,12 @@
 #pragma once
 
+// release and headless builds pass -DNDEBUG to drop debug logging and checks
+#ifndef NDEBUG
 #define DEBUG
+#endif
 
 #define ASSERT(_e, ...) if (!(_e)) { fprintf(stderr, "[ERROR] %s %d: ", __FILE__, __LINE__); fprintf(stderr, __VA_ARGS__);  exit(1); }
-#define LOG(...) do { fprintf(stderr, "[LOG] %s %d: ", __FILE__, __LINE__); fprintf(stderr, __VA_ARGS__); printf("\n"); } while (0)
+#define LOG(...) do { fprintf(stderr, "[LOG] %s %d: ", __FILE__, __LINE__); fprintf(stderr, __VA_ARGS__); fprintf(stderr, "\n"); } while (0)
 
 #ifdef DEBUG
 #define IFDEBUG_LOG(...) LOG(__VA_ARGS__)
@@ -19,4 +22,9 @@
 #define GAMEBOARD_WIDTH 8
 #define GAMEBOARD_HEIGHT 10
 #define GAMEBOARD_MAX (GAMEBOARD_WIDTH * GAMEBOARD_HEIGHT)
+// rows and columns are tracked as bits of a u64
+#define GRID_MAX_DIM 64
+
+// how long a settled cascade takes to slide into place
+#define FALL_ANIM_MS 200
 #define GAMEBOARD_OFFSET_X (SCREEN_WIDTH / 2) - ((GAMEBOARD_WIDTH * TILE_SIZE) / 2)
@@ -0,0 +1,30 @@
+#pragma once
+#include "types.h"
+
+// Bulk pixel kernels over spans of ABGR8888 pixels. Each has a scalar, an
+// SSE2 and an AVX2 version; the widest the CPU supports is picked at runtime.
+// All versions give bit-identical results.
+
+enum pixel_isa {
+    PIXEL_SCALAR,
+    PIXEL_SSE2,
+    PIXEL_AVX2,
+};
+
+// use isa, or the widest supported one below it, and return what was chosen
+enum pixel_isa pixels_use(enum pixel_isa isa);
+
+// the widest instruction set this CPU supports
+enum pixel_isa pixels_best_isa();
+
+const char *pixels_isa_name(enum pixel_isa isa);
+
+void pixels_fill(u32 *dst, u32 color, usize count);
+
+// dst may equal src in all of these
+void pixels_greyscale(u32 *dst, const u32 *src, usize count);
+void pixels_lighten(u32 *dst, const u32 *src, usize count);
+void pixels_darken(u32 *dst, const u32 *src, usize count);
+
+// dst[i] is the 2x2 box average of row0[2i], row0[2i + 1], row1[2i], row1[2i + 1]
+void pixels_halve_rows(u32 *dst, const u32 *row0, const u32 *row1, usize count);
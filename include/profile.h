@@ -0,0 +1,107 @@
+#pragma once
+#include "types.h"
+
+// Per-phase frame timings. PROFILE_SCOPE times the rest of the enclosing
+// block, and each phase's time is summed over the frame until
+// profile_frame_end keeps it in a window of recent frames and the CSV.
+// Scopes and counts may run on any thread. Without -DPROFILE they compile to
+// nothing.
+//
+// Phases are exclusive: a scope opened inside another on the same thread
+// takes its time out of the outer one, so update doesn't count the scan and
+// physics inside it again. The frame phase is the exception, it is the whole
+// pass of the main loop and holds the main thread's other phases.
+
+enum profile_phase {
+    PROFILE_FRAME,
+    PROFILE_DRAW_BG,
+    PROFILE_DRAW_GRID,
+    PROFILE_DRAW_RESTORE,
+    PROFILE_DRAW_TILES,
+    PROFILE_UPLOAD,
+    PROFILE_PRESENT,
+    PROFILE_UPDATE,
+    PROFILE_SCAN,
+    PROFILE_PHYSICS,
+    PROFILE_PHASE_COUNT,
+};
+
+extern const char *profile_phase_names[PROFILE_PHASE_COUNT];
+
+// Events counted per frame alongside the timings, with PROFILE_COUNT.
+enum profile_counter {
+    PROFILE_LINE_CACHE_HITS,
+    PROFILE_LINE_CACHE_MISSES,
+    PROFILE_COUNTER_COUNT,
+};
+
+extern const char *profile_counter_names[PROFILE_COUNTER_COUNT];
+
+// frames the rolling percentiles are taken over
+#define PROFILE_WINDOW 240
+
+// monotonic ns
+u64 profile_now(void);
+
+void profile_add(enum profile_phase phase, u64 ns);
+
+void profile_count(enum profile_counter counter, u64 n);
+
+// close the frame: keep its timings in the window and write them to the CSV
+void profile_frame_end(void);
+
+// frames closed so far
+u32 profile_frames(void);
+
+// the phase's time per frame p percent of the window is at or below, in ms
+double profile_percentile(enum profile_phase phase, double p);
+
+// the counter summed over the window
+u64 profile_counter_sum(enum profile_counter counter);
+
+// write a row of ms per phase for every frame from now on, -1 if file can't be created
+int profile_open_csv(const char *file);
+void profile_close_csv(void);
+
+struct profile_timer {
+    enum profile_phase phase;
+    u64 start;
+    // ns of the scopes opened inside this one
+    u64 nested;
+    struct profile_timer *outer;
+};
+
+// the innermost open scope of this thread
+extern _Thread_local struct profile_timer *profile_open_timer;
+
+// t is where the timer is being stored, it is the open scope until stopped
+static inline struct profile_timer profile_timer_start(enum profile_phase phase, struct profile_timer *t) {
+    struct profile_timer *outer = profile_open_timer;
+    profile_open_timer = t;
+    return (struct profile_timer){.phase = phase, .start = profile_now(), .outer = outer};
+}
+
+static inline void profile_timer_stop(struct profile_timer *t) {
+    u64 ns = profile_now() - t->start;
+
+    profile_open_timer = t->outer;
+    if (t->outer) {
+        t->outer->nested += ns;
+    }
+
+    profile_add(t->phase, t->phase == PROFILE_FRAME ? ns : ns - t->nested);
+}
+
+#ifdef PROFILE
+#define PROFILE_TIMER_NAME(_line) profile_timer_##_line
+#define PROFILE_TIMER(_phase, _line) \
+    struct profile_timer PROFILE_TIMER_NAME(_line) __attribute__((cleanup(profile_timer_stop))) = \
+        profile_timer_start(_phase, &PROFILE_TIMER_NAME(_line))
+#define PROFILE_SCOPE(_phase) PROFILE_TIMER(_phase, __LINE__)
+#define PROFILE_COUNT(_counter) profile_count(_counter, 1)
+#define PROFILE_FRAME_END() profile_frame_end()
+#else
+#define PROFILE_SCOPE(_phase)
+#define PROFILE_COUNT(_counter)
+#define PROFILE_FRAME_END()
+#endif
@@ -7,15 +7,60 @@
 void obj_render(obj_info_t *obj, SDL_Texture *tex);
 void sprite_render(int x, int y, sprite *s, SDL_Texture *tex);
 void pix_buf_render(int x, int y, int w, int h, u32 *pixels, SDL_Texture *tex);
-
-void verline(int x, int y0, int y1, u32 color, u32* pixels, int pix_buf_width);
+// like pix_buf_render, for a w x h window of a buffer whose rows are stride pixels apart
+void pix_buf_render_stride(int x, int y, int w, int h, u32 *pixels, int stride, SDL_Texture *tex);
 
 u32* line(int length, u32 color);
 
-void horiline(int x, int y0, int y1, u32 color, u32* pixels, int pix_buf_width);
-
 u32 *clone_pixels(u32 const * src, size_t len);
 
+// 3x5 pixel text of letters, digits and . - : /, scale x scale pixels per
+// font pixel. Lines are TEXT_LINE * scale pixels apart, the text must fit in
+// the buffer.
+#define TEXT_ADVANCE 4
+#define TEXT_LINE 7
+void draw_text(const char *text, int x, int y, int scale, u32 color, u32 *pixels, int pix_buf_width);
+
+// Static texture holding every sprite the game draws, uploaded once. Frames are
+// then drawn as textured quads from it, no pixels cross the bus per frame.
+#define ATLAS_WIDTH 1024
+#define ATLAS_MAX_SPRITES 256
+
+struct atlas {
+    SDL_Texture *texture;
+    int width, height;
+
+    u32 count;
+    SDL_Rect rects[ATLAS_MAX_SPRITES];
+
+    // a solid white block, tinted by vertex colour for fills and lines
+    SDL_Rect white;
+};
+
+// pack sprites into rows and upload them, false if the texture can't be made
+bool atlas_create(struct atlas *atlas, SDL_Renderer *renderer, sprite **sprites, u32 count);
+void atlas_destroy(struct atlas *atlas);
+
+// Quads from one atlas gathered into a single SDL_RenderGeometry call,
+// flushed automatically when full.
+#define BATCH_MAX_QUADS 512
+
+struct render_batch {
+    SDL_Renderer *renderer;
+    struct atlas *atlas;
+
+    u32 quads;
+    SDL_Vertex vertices[BATCH_MAX_QUADS * 4];
+    int indices[BATCH_MAX_QUADS * 6];
+};
+
+void batch_begin(struct render_batch *batch, SDL_Renderer *renderer, struct atlas *atlas);
+// draw atlas sprite `index` stretched over x, y, w, h
+void batch_sprite(struct render_batch *batch, u32 index, int x, int y, int w, int h);
+// fill x, y, w, h with an ABGR8888 colour
+void batch_fill(struct render_batch *batch, int x, int y, int w, int h, u32 color);
+void batch_flush(struct render_batch *batch);
+
 u32 greyscale(u32 pix);
 u32 darken(u32 pix);
 u32 lighten(u32 pix);
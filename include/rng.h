@@ -0,0 +1,40 @@
+#pragma once
+#include "types.h"
+
+// xoshiro256** generator. Each game owns one, so a seed replays the game
+// exactly and separate games never share state.
+struct rng {
+    u64 s[4];
+};
+
+// splitmix64's output mix, spreads any change of x over the whole result
+static inline u64 rng_mix(u64 z) {
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+// expand seed into the full state with splitmix64, any seed is valid
+void rng_seed(struct rng *r, u64 seed);
+
+static inline u64 rng_rotl(u64 x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+static inline u64 rng_next(struct rng *r) {
+    u64 *s = r->s;
+    u64 result = rng_rotl(s[1] * 5, 7) * 9;
+    u64 t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rng_rotl(s[3], 45);
+
+    return result;
+}
+
+// uniform in [0, n) without modulo bias, n must be > 0
+u32 rng_below(struct rng *r, u32 n);
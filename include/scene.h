@@ -0,0 +1,120 @@
+#pragma once
+#include "assets.h"
+#include "game.h"
+#include "obj.h"
+#include "sprite.h"
+#include "tile.h"
+#include "types.h"
+
+// What a frame shows, with no SDL dependency: the tile sprites baked once, the
+// list of sprites on screen built from a game each frame, the screen regions
+// that changed since the last presented frame, and the software compositor
+// that repaints those regions into a pixel buffer. The game uploads and
+// presents the result, tests and benchmarks drive the same path without a
+// window.
+
+#define BG_COLOR 0xCCCCDDFF
+#define GRID_LINE_COLOR 0xBBBBBBBB
+
+// every look a letter tile can take, indices 0-4 are the CON_* directions
+enum {
+    TILE_VARIANT_GREYED = CON_RIGHT + 1,
+    TILE_VARIANT_MARKED,
+    TILE_VARIANT_COUNT,
+};
+
+// atlas slots: the tile variants letter by letter, then the queue border
+#define ATLAS_TILE(_letter, _variant) ((_letter) * TILE_VARIANT_COUNT + (_variant))
+#define ATLAS_QUEUE_BORDER (26 * TILE_VARIANT_COUNT)
+
+// a region of the screen, laid out like SDL_Rect
+struct rect {
+    int x, y, w, h;
+};
+
+// one sprite placed on screen, a NULL sprite leaves its slot empty
+struct draw_item {
+    sprite *sprite;
+    u32 atlas_index;
+    struct rect dst;
+};
+
+// slots after the board cells in the draw list
+enum {
+    DRAW_QUEUE_BORDER,
+    DRAW_QUEUE_TILE,
+    DRAW_PLAYER = DRAW_QUEUE_TILE + 2,
+    DRAW_EXTRA_SLOTS = DRAW_PLAYER + 2,
+};
+
+// Screen regions that changed since the last presented frame. Overlapping
+// rectangles are merged as they are added, so the list stays disjoint.
+#define DAMAGE_MAX_RECTS 32
+
+struct damage {
+    u32 count;
+    struct rect rects[DAMAGE_MAX_RECTS];
+};
+
+void damage_clear(struct damage *d);
+// add r clipped to the screen, false if it was already covered
+bool damage_add(struct damage *d, struct rect r);
+bool damage_intersects(const struct damage *d, struct rect r);
+
+struct scene {
+    struct assets *assets;
+
+    // baked once in scene_init so drawing a tile never touches the heap
+    sprite tile_variants[26][TILE_VARIANT_COUNT];
+
+    // the board's cells and the queue preview's box on screen
+    u32 cols, rows;
+    obj_info_t grid;
+    obj_info_t queue;
+
+    // render views of the game's board, falling pair and queue, rebuilt
+    // every frame
+    tile_t *tiles;
+    tile_t queue_tiles[2];
+    bool player_active;
+    tile_t player[2];
+
+    // what is on screen this frame and what the last presented frame showed
+    struct draw_item *items;
+    struct draw_item *drawn;
+    u32 count;
+
+    struct damage damage;
+
+    // recomposite everything: first frame, or the window lost its contents
+    bool full;
+
+    // background and grid, flattened to opaque colours
+    u32 *background;
+    // the background with the sprites blended in, what the software path shows
+    u32 *screen;
+};
+
+// bake every tile variant from assets and lay out a cols x rows board
+void scene_init(struct scene *s, struct assets *assets, u32 cols, u32 rows);
+
+void scene_destroy(struct scene *s);
+
+// Rebuild the draw list from g as it looks at simulation time clock (ms) and
+// damage every slot whose item moved, changed or disappeared since the last
+// presented frame. Returns the damaged region count, 0 if nothing changed.
+u32 scene_update(struct scene *s, const struct game *g, double clock);
+
+// repaint the damaged regions of s->screen: restore the background, then
+// blend every sprite that touches a region over it in draw order
+void scene_composite(struct scene *s);
+
+// the frame was presented, damage is taken against it from now on
+void scene_presented(struct scene *s);
+
+// lines of a colour, y1 and x1 included
+void verline(int x, int y0, int y1, u32 color, u32* pixels, int pix_buf_width);
+void horiline(int x0, int x1, int y, u32 color, u32* pixels, int pix_buf_width);
+
+// pix blended over opaque black
+u32 flatten(u32 pix);
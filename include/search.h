@@ -0,0 +1,94 @@
+#pragma once
+#include "board.h"
+#include "game.h"
+#include "trie.h"
+#include "ttable.h"
+#include "types.h"
+
+// Placement search for the falling pair. Finds every position the pair can
+// land in through the game's own moves (shifts, rotations with their kicks,
+// drops) and the flip. Each one is landed on a copy of the board and the
+// scan, clear and gravity cascade is played out, so placements can be ranked
+// by what they clear.
+
+// pair positions: a cell for t1 and one of four sides for t2
+#define SEARCH_MAX_STATES (GRID_MAX_DIM * GRID_MAX_DIM * 4)
+// every landing, flipped and not
+#define SEARCH_MAX_PLACEMENTS (SEARCH_MAX_STATES * 2)
+
+struct search_placement {
+    // where the pair lands, letters, positions and connections
+    struct game_tile t1, t2;
+
+    // what the cascade after landing clears
+    u32 words;
+    u32 tiles;
+    // scans that found words, 1 for a plain clear, more for chain reactions
+    u32 chain;
+    // rows the stack is tall once everything is at rest
+    u32 height;
+
+    // set by search_best: the most words the queued pair can clear next, and
+    // whether the queued pair can't even spawn
+    u32 next_words;
+    bool blocks_spawn;
+};
+
+// Scratch for one search at a time. It is large, keep one per thread.
+struct search {
+    struct dict_trie *dict; // only read
+
+    // Optional, set after search_init. Caches what a landing clears and what
+    // the queued pair can clear after it, keyed on the board's hash, so
+    // boards reached again through other placements or later searches are
+    // not played out twice. One table can be shared by every thread searching
+    // with the same dictionary and board size.
+    struct ttable *table;
+
+    // Optional, set after search_init. The line cache the scans of played
+    // out boards use, never shared with another thread.
+    struct line_cache *lines;
+
+    // Per side t2 is on, bit x of row y for t1 at (x, y): the states the
+    // pair fits in, those it can be moved to and those whose rotations have
+    // been followed. Then per rotation, clockwise first, the states that
+    // turn in place and those that turn kicked a column over.
+    u64 fits[4][GRID_MAX_DIM];
+    u64 reach[4][GRID_MAX_DIM];
+    u64 rotated[4][GRID_MAX_DIM];
+    u64 turns[2][4][GRID_MAX_DIM];
+    u64 kicks[2][4][GRID_MAX_DIM];
+
+    // what board_filled says of the rows around each row, shifted by up to
+    // two columns either way, off the board included
+    u64 blocked[5][GRID_MAX_DIM + 2];
+
+    // landings and the board after them, per ply of search_best
+    u16 landings[2][SEARCH_MAX_STATES];
+    struct board boards[2];
+
+    // Per ply, the board landings are evaluated on, if it is at rest with
+    // every connection matched. A landing can't set anything moving on it,
+    // so one that clears nothing is scanned in place instead of played out.
+    struct board rest[2];
+    bool at_rest[2];
+    u32 rest_height[2];
+
+    // placements played out so far
+    u64 evaluated;
+};
+
+void search_init(struct search *s, struct dict_trie *dict);
+
+// every placement of t1, t2 on b from where they are now, each played out,
+// into out (at most capacity). Returns how many there are.
+u32 search_placements(struct search *s, const struct board *b, struct game_tile t1, struct game_tile t2,
+                      struct search_placement *out, u32 capacity);
+
+// order placements best first: more words, then more tiles, then a lower stack
+void search_sort(struct search_placement *placements, u32 count);
+
+// The best placement of g's falling pair, looking ahead at the queued pair.
+// Placements that let the next pair spawn come first, then the most words
+// over both pairs, then as search_sort. False if there is no falling pair.
+bool search_best(struct search *s, const struct game *g, struct search_placement *best);
@@ -0,0 +1,93 @@
+#pragma once
+#include <stdatomic.h>
+
+#include "game.h"
+#include "types.h"
+
+// Fixed-timestep driver for a game. The simulation clock advances in
+// SIM_STEP_MS steps however late or often sim_advance is called, input is
+// queued as commands stamped with when they happened and applied in order
+// between the steps they fall between, and each finished state is handed
+// to the renderer through a triple buffer. Queue and buffer are lock free with
+// one producer and one consumer, so the simulation may run on its own thread.
+
+#define SIM_STEP_MS 10
+// wall time caught up in one call at most, a longer stall is dropped
+#define SIM_MAX_CATCHUP_MS 250
+// must be a power of two
+#define SIM_COMMAND_CAPACITY 64
+
+enum sim_command {
+    SIM_SHIFT_LEFT,
+    SIM_SHIFT_RIGHT,
+    SIM_DROP,
+    SIM_ROTATE_CW,
+    SIM_ROTATE_CCW,
+    SIM_FLIP,
+    SIM_QUIT,
+};
+
+struct sim_input {
+    enum sim_command command;
+    double time; // wall time (ms) the input happened
+};
+
+// the game as of simulation time `clock`, reached at wall time `wall` (ms)
+struct sim_snapshot {
+    struct game game;
+    double clock;
+    double wall;
+    // how many pushed commands the state includes
+    u32 inputs;
+};
+
+// set in sim.middle while the reader has not picked the slot up
+#define SIM_SNAPSHOT_FRESH 4u
+
+struct sim {
+    // owned by whichever thread calls sim_advance
+    struct game *game;
+    double clock;
+    double accumulator;
+    double wall;
+
+    // commands, written by sim_push and consumed by sim_advance
+    _Atomic u32 command_head;
+    _Atomic u32 command_tail;
+    struct sim_input inputs[SIM_COMMAND_CAPACITY];
+
+    // GAME_EVENT_* bits not yet taken by the reader
+    _Atomic u32 events;
+
+    // triple buffer: the writer fills back, the reader holds front, and they
+    // swap slots with middle
+    struct sim_snapshot snapshots[3];
+    _Atomic u32 middle;
+    u32 back;
+    u32 front;
+};
+
+// drive g from wall time now (ms), publishing its current state
+void sim_init(struct sim *sim, struct game *g, double now);
+
+// queue a command that happened at wall time `time` (ms), false if the queue is full
+bool sim_push(struct sim *sim, enum sim_command command, double time);
+
+// run every step due by wall time now (ms), applying each queued command
+// before the first step at or after it, false once the game has quit
+bool sim_advance(struct sim *sim, double now);
+
+// ms of wall time until the next step is due
+double sim_until_step(const struct sim *sim);
+
+// the newest published state, valid until the next call
+const struct sim_snapshot *sim_snapshot(struct sim *sim);
+
+// GAME_EVENT_* bits raised since the last call
+u32 sim_take_events(struct sim *sim);
+
+// simulation time at wall time now, running on from the snapshot. The game only
+// changes on steps, so this is what animations between them are drawn at.
+static inline double sim_snapshot_clock(const struct sim_snapshot *s, double now) {
+    return now > s->wall ? s->clock + (now - s->wall) : s->clock;
+}
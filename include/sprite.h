@@ -1,20 +1,58 @@
 #pragma once
 #include "types.h"
 
+// blits filter a row at a time through a buffer this wide, and every
+// sprite is held to it
 #define SPRITE_MAX_W 256
 #define SPRITE_MAX_H 256
 
 typedef struct {
     usize width, height;
     u32 *pixels;
+    // per row, the longest run of full-alpha pixels, from included and to
+    // excluded, which blits copy instead of blending
+    u16 opaque_from[SPRITE_MAX_H];
+    u16 opaque_to[SPRITE_MAX_H];
 } sprite;
 
+// a window into a pixel buffer whose rows are stride pixels apart
+struct blit_target {
+    u32 *pixels;
+    int width, height, stride;
+};
+
+// colour change applied to each pixel on its way to the target
+enum blit_filter {
+    BLIT_PLAIN,
+    BLIT_GREYSCALE,
+    BLIT_LIGHTEN,
+};
+
+// tint that leaves pixels as they are
+#define BLIT_NO_TINT 0xFFFFFFFF
+
+// draw sp with its top left at x, y, clipped to dst. Pixels go through filter
+// and are then multiplied channel by channel by tint. The opaque span of each
+// row is copied, the pixels either side of it are premultiplied and blended
+// over what dst holds.
+void sprite_blit(const sprite *sp, int x, int y, struct blit_target dst, enum blit_filter filter, u32 tint);
+
 void sprite_push_to_buf(sprite sp, int x, int y, u32 *buf, u32 buf_width, u32 buf_height);
 
 sprite sprite_create(usize w, usize h, u32 color);
 
 sprite sprite_create_from(usize w, usize h, u32* pixels);
 
+// a sprite over pixels owned by someone else, nothing is copied
+sprite sprite_wrap(usize w, usize h, u32 *pixels);
+
+// find the opaque span of every row again, after writing to sp's pixels
+void sprite_find_opaque(sprite *sp);
+
 void sprite_pixel_color(sprite *sp, int x, int y, u32 color);
 
+// box-average sp down by an integer factor into dst, which the caller sizes to
+// (sp->width / factor) x (sp->height / factor); leftover edge pixels are dropped
+void sprite_downscale(const sprite *sp, u32 factor, sprite *dst);
+
 void sprite_paint_over(sprite *sp, int x, int y, int w, int h, u32 *pixels);
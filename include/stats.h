@@ -0,0 +1,22 @@
+#pragma once
+#include "types.h"
+
+// Measurements collected over a session, summarised by percentile.
+struct samples {
+    double *values;
+    u32 count;
+    u32 capacity;
+    bool sorted;
+};
+
+void samples_init(struct samples *s);
+
+void samples_destroy(struct samples *s);
+
+// make room for capacity samples, so adding up to that many never allocates
+void samples_reserve(struct samples *s, u32 capacity);
+
+void samples_add(struct samples *s, double value);
+
+// the value p percent of the samples are at or below (nearest rank), 0 if empty
+double samples_percentile(struct samples *s, double p);
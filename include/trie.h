@@ -1,25 +1,146 @@
+#pragma once
 #include "tile.h"
 #include "types.h"
 #define MAX_CHILDREN 26
 
-struct dict_trie_node {
-    struct dict_trie_node* children[MAX_CHILDREN]; // Array to store child nodes for each letter (assuming only lowercase alphabets)
-    bool is_end_of_word; // Flag to mark the end of a word
+// bit set in dict_node.mask when the path to the node spells a word
+#define DICT_END_OF_WORD (1u << 31)
+
+// Compact, read-only dictionary node. The children of a node are stored
+// contiguously from `first` in letter order, so the child for letter i sits at
+// first + popcount(mask & ((1 << i) - 1)). Identical child blocks are shared,
+// which turns the trie into a minimized DAWG living in one buffer.
+struct dict_node {
+    u32 mask;  // bits 0-25: which letters have a child, DICT_END_OF_WORD flag
+    u32 first; // index of the first child in dict_trie.nodes
+};
+
+// Mutable node used while words are being inserted, linked by index into one
+// growable array (first child / next sibling, siblings sorted by letter).
+struct dict_build_node {
+    u32 child;
+    u32 sibling;
+    u8 letter;
+    bool is_end_of_word;
+};
+
+#define DICT_IMAGE_MAGIC 0x47574244 // "DBWG" in a little endian file
+#define DICT_IMAGE_VERSION 1
+
+// Header of a precompiled dictionary image. The compact nodes follow it
+// directly and only refer to each other by index, so the file can be mapped
+// anywhere and used in place. The source fields detect a stale image.
+struct dict_image_header {
+    u32 magic;
+    u32 version;
+    u32 node_count;
+    u32 source_checksum;
+    u64 source_size;
+    i64 source_mtime;
 };
 
-struct dict_trie_node* trie_node_create();
+struct dict_trie {
+    // compacted form, nodes[0] is the root
+    struct dict_node *nodes;
+    u32 node_count;
+
+    // set when nodes live in a mapped dictionary image instead of the heap
+    void *map;
+    usize map_size;
+
+    // staging trie, only present between trie_insert_word and trie_compact
+    struct dict_build_node *build;
+    u32 build_count;
+    u32 build_capacity;
+};
+
+// Memo of trie_longest_word for lines of up to LINE_CACHE_MAX_LEN cells. A
+// line packs into a key of 5 bits per cell from the first, a-z as 1-26 and
+// anything else as 0 since no word crosses it, with the length cap in bits
+// 50-53. The key and the result fit one u64 slot. The cache is open
+// addressed over LINE_CACHE_PROBES slots from the key's hash, and when all of
+// them are taken the first is replaced. The dictionary stays read-only, each
+// thread that scans keeps a cache of its own, good for one dictionary.
+#define LINE_CACHE_MAX_LEN 10
+#define LINE_CACHE_SLOTS (1 << 15)
+#define LINE_CACHE_PROBES 4
+
+struct line_cache {
+    u64 *slots;
+
+    // lookups that found their line and ones that didn't
+    u64 hits;
+    u64 misses;
+};
+
+struct dict_trie* trie_create();
 
 // destroy the trie
-void trie_destroy(struct dict_trie_node* node);
+void trie_destroy(struct dict_trie* dict);
 
 // insert a word into the trie
-void trie_insert_word(struct dict_trie_node* root, const char* word);
+void trie_insert_word(struct dict_trie* dict, const char* word);
+
+// minimize the inserted words into the compact read-only form
+void trie_compact(struct dict_trie* dict);
 
-// search a trie from the dictionary file
-int trie_construct(struct dict_trie_node* root, const char* dict_file);
+// construct the trie from the dictionary file
+int trie_construct(struct dict_trie* dict, const char* dict_file);
+
+// map a precompiled image of dict_file, returns 0 on success and -1 if the image
+// is missing, malformed or older than dict_file
+int trie_load_image(struct dict_trie* dict, const char* image_file, const char* dict_file);
+
+// write the compacted trie as an image that trie_load_image can map
+int trie_write_image(struct dict_trie* dict, const char* image_file, const char* dict_file);
+
+// load the dictionary image, falling back to parsing dict_file
+int trie_load(struct dict_trie* dict, const char* image_file, const char* dict_file);
 
 // search the trie for a word
-bool trie_search_word(struct dict_trie_node* root, const char* word);
+bool trie_search_word(struct dict_trie* dict, const char* word);
+
+// find the longest viable word of at most max_len letters in str (leftmost on
+// ties), sets [*start, *end) and returns true if there is one
+bool trie_longest_word(struct dict_trie* dict, const char* str, int len, int max_len, int* start, int* end);
+
+// a cell's 5 bit code in a line key
+static inline u64 trie_line_code(char c) {
+    u32 index = (u8)c - 'a';
+    return index < 26 ? index + 1 : 0;
+}
+
+static inline u64 trie_line_key(u64 codes, int max_len) {
+    // Past the end reads as empty cells, so a line is the same line padded
+    // to LINE_CACHE_MAX_LEN and a cap over that changes nothing
+    u64 cap = max_len < LINE_CACHE_MAX_LEN ? max_len : LINE_CACHE_MAX_LEN;
+    return codes | cap << 50;
+}
+
+// false if a line whose letters are the set bits of cells can't hold a word,
+// which takes three letters in a row
+static inline bool trie_line_may_hold_word(u64 cells, int max_len) {
+    return max_len >= 3 && (cells & (cells >> 1) & (cells >> 2));
+}
+
+void line_cache_init(struct line_cache* cache);
+
+void line_cache_destroy(struct line_cache* cache);
+
+// forget every line and zero the counters, for a cache moving to another dictionary
+void line_cache_clear(struct line_cache* cache);
+
+// true and the cached result in found, start and end if key is cached
+bool line_cache_lookup(struct line_cache* cache, u64 key, bool* found, int* start, int* end);
+
+void line_cache_store(struct line_cache* cache, u64 key, bool found, int start, int end);
+
+// share of lookups that hit, 0 before the first lookup
+double line_cache_hit_rate(const struct line_cache* cache);
+
+// trie_longest_word through cache, for lines of letters and spaces. A NULL
+// cache walks the trie every time.
+bool trie_longest_line(struct dict_trie* dict, struct line_cache* cache, const char* str, int len, int max_len, int* start, int* end);
 
 // word is viable if it contains and vowel and a consonant
 const bool check_word_viability(char* word);
@@ -28,4 +149,5 @@ const bool check_word_viability(char* word);
 const bool check_string_validity(const char* substring);
 
 // check for words in a given row of characters
-const bool check_substrings(const char *str, u32 *indices, tile_t *tiles, usize grid_w, usize grid_h, struct dict_trie_node *dict);
+const bool check_substrings(const char *str, u32 *indices, tile_t *tiles, usize grid_w, usize grid_h, struct dict_trie *dict,
+                            struct line_cache *cache);
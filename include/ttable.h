@@ -0,0 +1,41 @@
+#pragma once
+#include <stdatomic.h>
+
+#include "types.h"
+
+// Fixed-size transposition table from 64-bit keys (board hashes) to 64 bits
+// of data, shared by any number of threads without locks. Each slot holds
+// the data and the key XORed with it, both written with plain atomic stores.
+// A slot torn by two writers no longer XORs back to a key, so a probe can't
+// return another key's data, it just misses. A store always replaces what
+// the slot held.
+
+struct ttable_entry {
+    _Atomic u64 check; // key ^ data
+    _Atomic u64 data;
+};
+
+struct ttable {
+    struct ttable_entry *entries;
+    u64 mask; // entry count - 1, a power of two
+
+    // every probe and the ones that found their key, for sizing the table
+    _Atomic u64 probes;
+    _Atomic u64 hits;
+};
+
+// a table of 2^bits entries, 16 bytes each
+void ttable_init(struct ttable *t, u32 bits);
+
+void ttable_destroy(struct ttable *t);
+
+// empty every slot and zero the counters, not safe while other threads use t
+void ttable_clear(struct ttable *t);
+
+// true and the data stored for key in data, if it is still there
+bool ttable_probe(struct ttable *t, u64 key, u64 *data);
+
+void ttable_store(struct ttable *t, u64 key, u64 data);
+
+// share of probes that hit, 0 before the first probe
+double ttable_hit_rate(const struct ttable *t);
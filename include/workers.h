@@ -0,0 +1,22 @@
+#pragma once
+#include "types.h"
+
+// Work-stealing pool for a fixed set of independent jobs. The jobs are dealt
+// out in contiguous blocks, one deque per thread. Each thread works through its
+// own block from the bottom, and once it runs dry it steals from the top of
+// the others' (Chase-Lev), so uneven jobs still keep every thread busy.
+
+// run job `job` on worker thread `worker`, in [0, thread_count)
+typedef void (*worker_job_fn)(u32 job, u32 worker, void *arg);
+
+struct workers_stats {
+    // jobs run by a thread other than the one they were dealt to
+    u64 steals;
+};
+
+// threads the machine can run at once
+u32 workers_cpu_count(void);
+
+// run fn for every job in [0, job_count) on thread_count threads and return
+// when all are done. stats may be NULL.
+void workers_run(u32 thread_count, u32 job_count, worker_job_fn fn, void *arg, struct workers_stats *stats);
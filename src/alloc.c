@@ -0,0 +1,30 @@
+#include "../include/alloc.h"
+
+_Thread_local usize alloc_count = 0;
+
+void arena_init(struct arena *a, usize size) {
+    // malloc already aligns for any type, which covers ARENA_ALIGN
+    a->base = ALLOC(size);
+    a->size = a->base ? size : 0;
+    a->used = 0;
+}
+
+void *arena_alloc(struct arena *a, usize n) {
+    usize start = (a->used + ARENA_ALIGN - 1) & ~(usize)(ARENA_ALIGN - 1);
+    if (start > a->size || n > a->size - start) {
+        return NULL;
+    }
+
+    a->used = start + n;
+    return a->base + start;
+}
+
+void arena_reset(struct arena *a) {
+    a->used = 0;
+}
+
+void arena_destroy(struct arena *a) {
+    free(a->base);
+    a->base = NULL;
+    a->size = a->used = 0;
+}
@@ -0,0 +1,230 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+
+#include "../include/assets.h"
+#include "../include/macros.h"
+#include "../include/alloc.h"
+
+const char *asset_files[ASSET_COUNT] = {
+    "gfx/TileA.png", "gfx/TileB.png", "gfx/TileC.png", "gfx/TileD.png",
+    "gfx/TileE.png", "gfx/TileF.png", "gfx/TileG.png", "gfx/TileH.png",
+    "gfx/TileI.png", "gfx/TileJ.png", "gfx/TileK.png", "gfx/TileL.png",
+    "gfx/TileM.png", "gfx/TileN.png", "gfx/TileO.png", "gfx/TileP.png",
+    "gfx/TileQ.png", "gfx/TileR.png", "gfx/TileS.png", "gfx/TileT.png",
+    "gfx/TileU.png", "gfx/TileV.png", "gfx/TileW.png", "gfx/TileX.png",
+    "gfx/TileY.png", "gfx/TileZ.png",
+    "gfx/QueueBorder.png",
+};
+
+// drop the pixel block, whether it was allocated or mapped
+static void assets_release(struct assets *assets) {
+    if (assets->map) {
+        munmap(assets->map, assets->map_size);
+    } else {
+        free(assets->pixels);
+    }
+
+    memset(assets, 0, sizeof(*assets));
+}
+
+int assets_decode(struct assets *assets) {
+    SDL_Surface *surfaces[ASSET_COUNT] = {0};
+    u32 pixel_count = 0;
+    int result = 0;
+
+    // decode and convert everything first so the block is allocated once
+    for (int i = 0; i < ASSET_COUNT; i++) {
+        SDL_Surface *loaded = IMG_Load(asset_files[i]);
+        if (loaded == NULL) {
+            LOG("Couldn't load %s: %s", asset_files[i], SDL_GetError());
+            result = -1;
+            break;
+        }
+
+        surfaces[i] = SDL_ConvertSurfaceFormat(loaded, SDL_PIXELFORMAT_ABGR8888, 0);
+        SDL_FreeSurface(loaded);
+        if (surfaces[i] == NULL) {
+            LOG("Couldn't convert %s: %s", asset_files[i], SDL_GetError());
+            result = -1;
+            break;
+        }
+
+        if (surfaces[i]->w > SPRITE_MAX_W || surfaces[i]->h > SPRITE_MAX_H) {
+            LOG("%s is %dx%d, larger than the %dx%d a sprite can be", asset_files[i], surfaces[i]->w, surfaces[i]->h, SPRITE_MAX_W, SPRITE_MAX_H);
+            result = -1;
+            break;
+        }
+
+        pixel_count += surfaces[i]->w * surfaces[i]->h;
+    }
+
+    if (result == 0) {
+        assets_release(assets);
+        assets->pixels = ALLOC(sizeof(u32) * pixel_count);
+        ASSERT(assets->pixels, "unable to allocate %u asset pixels\n", pixel_count);
+        assets->pixel_count = pixel_count;
+
+        u32 offset = 0;
+        for (int i = 0; i < ASSET_COUNT; i++) {
+            SDL_Surface *s = surfaces[i];
+            u32 *pixels = &assets->pixels[offset];
+
+            // surface rows may be padded out to pitch
+            for (int y = 0; y < s->h; y++) {
+                memcpy(&pixels[y * s->w], (u8 *)s->pixels + y * s->pitch, sizeof(u32) * s->w);
+            }
+
+            assets->sprites[i] = sprite_wrap(s->w, s->h, pixels);
+            offset += s->w * s->h;
+        }
+
+        LOG("Decoded %d images into %u pixels", ASSET_COUNT, pixel_count);
+    }
+
+    for (int i = 0; i < ASSET_COUNT; i++) {
+        if (surfaces[i]) SDL_FreeSurface(surfaces[i]);
+    }
+
+    return result;
+}
+
+// a sheet is fresh if each image is unchanged, or missing altogether
+static bool sheet_is_fresh(const struct asset_sheet_header *header) {
+    for (int i = 0; i < ASSET_COUNT; i++) {
+        struct stat st;
+        if (stat(asset_files[i], &st) != 0) continue;
+
+        if ((u64)st.st_size != header->entries[i].source_size || (i64)st.st_mtime != header->entries[i].source_mtime) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// every entry lies inside the pixel block and fits a sprite
+static bool sheet_is_valid(const struct asset_sheet_header *header, usize size) {
+    if (header->magic != ASSET_SHEET_MAGIC ||
+        header->version != ASSET_SHEET_VERSION ||
+        header->count != ASSET_COUNT ||
+        size != sizeof(struct asset_sheet_header) + (usize)header->pixel_count * sizeof(u32)) {
+        return false;
+    }
+
+    for (int i = 0; i < ASSET_COUNT; i++) {
+        const struct asset_sheet_entry *e = &header->entries[i];
+        if (e->width > SPRITE_MAX_W || e->height > SPRITE_MAX_H ||
+            (u64)e->offset + (u64)e->width * e->height > header->pixel_count) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int assets_load_sheet(struct assets *assets, const char *sheet_file) {
+    int fd = open(sheet_file, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (usize)st.st_size < sizeof(struct asset_sheet_header)) {
+        close(fd);
+        return -1;
+    }
+
+    usize size = st.st_size;
+    void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (map == MAP_FAILED) {
+        return -1;
+    }
+
+    const struct asset_sheet_header *header = map;
+
+    if (!sheet_is_valid(header, size)) {
+        LOG("Sprite sheet %s is malformed", sheet_file);
+        munmap(map, size);
+        return -1;
+    }
+
+    if (!sheet_is_fresh(header)) {
+        LOG("Sprite sheet %s is stale", sheet_file);
+        munmap(map, size);
+        return -1;
+    }
+
+    assets_release(assets);
+
+    assets->map = map;
+    assets->map_size = size;
+    assets->pixels = (u32 *)(header + 1);
+    assets->pixel_count = header->pixel_count;
+
+    // the mapping is read only, nothing writes to loaded sprites
+    for (int i = 0; i < ASSET_COUNT; i++) {
+        const struct asset_sheet_entry *e = &header->entries[i];
+        assets->sprites[i] = sprite_wrap(e->width, e->height, &assets->pixels[e->offset]);
+    }
+
+    LOG("Mapped sprite sheet %s (%u pixels)", sheet_file, assets->pixel_count);
+
+    return 0;
+}
+
+int assets_write_sheet(struct assets *assets, const char *sheet_file) {
+    struct asset_sheet_header header = {
+        .magic = ASSET_SHEET_MAGIC,
+        .version = ASSET_SHEET_VERSION,
+        .count = ASSET_COUNT,
+        .pixel_count = assets->pixel_count,
+    };
+
+    for (int i = 0; i < ASSET_COUNT; i++) {
+        struct stat st;
+        if (stat(asset_files[i], &st) != 0) {
+            return -1;
+        }
+
+        sprite *sp = &assets->sprites[i];
+        header.entries[i] = (struct asset_sheet_entry){
+            .width = sp->width,
+            .height = sp->height,
+            .offset = sp->pixels - assets->pixels,
+            .source_size = st.st_size,
+            .source_mtime = st.st_mtime,
+        };
+    }
+
+    FILE *file = fopen(sheet_file, "wb");
+    if (file == NULL) {
+        return -1;
+    }
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+              fwrite(assets->pixels, sizeof(u32), assets->pixel_count, file) == assets->pixel_count;
+
+    return (fclose(file) == 0 && ok) ? 0 : -1;
+}
+
+int assets_load(struct assets *assets, const char *sheet_file) {
+    if (assets_load_sheet(assets, sheet_file) == 0) {
+        return 0;
+    }
+
+    return assets_decode(assets);
+}
+
+void assets_destroy(struct assets *assets) {
+    assets_release(assets);
+}
@@ -0,0 +1,419 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/board.h"
+
+// bits [start, end) of a row mask
+static inline u64 span_mask(int start, int end) {
+    u64 bits = (end - start) >= 64 ? ~0ull : (1ull << (end - start)) - 1;
+    return bits << start;
+}
+
+void board_init(struct board *b, u32 width, u32 height) {
+    ASSERT(width <= GRID_MAX_DIM && height <= GRID_MAX_DIM, "board %ux%u exceeds max dimension %d", width, height, GRID_MAX_DIM);
+
+    memset(b, 0, sizeof(*b));
+    b->width = width;
+    b->height = height;
+
+    b->dirty_rows = ~0ull;
+    b->dirty_cols = ~0ull;
+}
+
+void board_copy(struct board *dst, const struct board *src) {
+    usize rows = sizeof(u64) * src->height;
+
+    dst->width = src->width;
+    dst->height = src->height;
+
+    memcpy(dst->filled, src->filled, rows);
+    memcpy(dst->greyed, src->greyed, rows);
+    memcpy(dst->marked, src->marked, rows);
+    memcpy(dst->con_up, src->con_up, rows);
+    memcpy(dst->con_down, src->con_down, rows);
+    memcpy(dst->con_left, src->con_left, rows);
+    memcpy(dst->con_right, src->con_right, rows);
+    memcpy(dst->letters, src->letters, src->width * src->height);
+
+    dst->dirty_rows = src->dirty_rows;
+    dst->dirty_cols = src->dirty_cols;
+    dst->found_count = 0;
+    dst->hash = src->hash;
+}
+
+u8 board_connection(const struct board *b, int x, int y) {
+    u64 bit = 1ull << x;
+
+    if (b->con_up[y] & bit) return CON_UP;
+    if (b->con_down[y] & bit) return CON_DOWN;
+    if (b->con_left[y] & bit) return CON_LEFT;
+    if (b->con_right[y] & bit) return CON_RIGHT;
+
+    return CON_NONE;
+}
+
+// the cell's share of the hash, 0 if it is empty
+static u64 cell_key(const struct board *b, int x, int y) {
+    if (!((b->filled[y] >> x) & 1)) {
+        return 0;
+    }
+    return board_zobrist(x, y, board_letter(b, x, y), board_greyed(b, x, y), board_connection(b, x, y));
+}
+
+u64 board_compute_hash(const struct board *b) {
+    u64 hash = 0;
+    for (int y = 0; y < b->height; y++) {
+        for (u64 bits = b->filled[y]; bits; bits &= bits - 1) {
+            hash ^= cell_key(b, __builtin_ctzll(bits), y);
+        }
+    }
+    return hash;
+}
+
+void board_clear_cell(struct board *b, int x, int y) {
+    u64 keep = ~(1ull << x);
+
+    b->hash ^= cell_key(b, x, y);
+
+    b->filled[y] &= keep;
+    b->greyed[y] &= keep;
+    b->marked[y] &= keep;
+    b->con_up[y] &= keep;
+    b->con_down[y] &= keep;
+    b->con_left[y] &= keep;
+    b->con_right[y] &= keep;
+    b->letters[y * b->width + x] = '\0';
+
+    b->dirty_rows |= 1ull << y;
+    b->dirty_cols |= 1ull << x;
+}
+
+void board_set(struct board *b, int x, int y, u8 letter, bool greyed, u8 connected) {
+    u64 bit = 1ull << x;
+
+    board_clear_cell(b, x, y);
+
+    b->filled[y] |= bit;
+    if (greyed) b->greyed[y] |= bit;
+
+    switch (connected) {
+        case CON_UP: b->con_up[y] |= bit; break;
+        case CON_DOWN: b->con_down[y] |= bit; break;
+        case CON_LEFT: b->con_left[y] |= bit; break;
+        case CON_RIGHT: b->con_right[y] |= bit; break;
+        default: break;
+    }
+
+    b->letters[y * b->width + x] = letter;
+    b->hash ^= cell_key(b, x, y);
+}
+
+bool board_update_connections(struct board *b) {
+    bool updated = false;
+
+    for (int y = 0; y < b->height; y++) {
+        // a connection survives only if the neighbour points back
+        u64 left = b->con_left[y] & (b->con_right[y] << 1);
+        u64 right = b->con_right[y] & (b->con_left[y] >> 1);
+        u64 up = y > 0 ? b->con_up[y] & b->con_down[y - 1] : 0;
+        u64 down = y + 1 < b->height ? b->con_down[y] & b->con_up[y + 1] : 0;
+
+        u64 changed = (left ^ b->con_left[y]) | (right ^ b->con_right[y]) | (up ^ b->con_up[y]) | (down ^ b->con_down[y]);
+        if (!changed) {
+            continue;
+        }
+
+        for (u64 bits = changed; bits; bits &= bits - 1) {
+            b->hash ^= cell_key(b, __builtin_ctzll(bits), y);
+        }
+
+        b->con_left[y] = left;
+        b->con_right[y] = right;
+        b->con_up[y] = up;
+        b->con_down[y] = down;
+
+        for (u64 bits = changed; bits; bits &= bits - 1) {
+            b->hash ^= cell_key(b, __builtin_ctzll(bits), y);
+        }
+        updated = true;
+    }
+
+    return updated;
+}
+
+static inline void fall_bits(u64 *rows, int y, u64 bits) {
+    rows[y + 1] |= rows[y] & bits;
+    rows[y] &= ~bits;
+}
+
+bool board_fall_step(struct board *b) {
+    bool updated = false;
+
+    // bottom up, so a tile moves at most one row per step
+    for (int y = (int)b->height - 2; y >= 0; y--) {
+        u64 loose = b->filled[y] & ~b->greyed[y] & ~b->filled[y + 1];
+
+        // the halves of a horizontal pair only fall together
+        u64 held = (b->con_left[y] & ~(loose << 1)) | (b->con_right[y] & ~(loose >> 1));
+        u64 falls = loose & ~held;
+
+        if (!falls) {
+            continue;
+        }
+
+        for (u64 bits = falls; bits; bits &= bits - 1) {
+            b->hash ^= cell_key(b, __builtin_ctzll(bits), y);
+        }
+
+        fall_bits(b->filled, y, falls);
+        fall_bits(b->marked, y, falls);
+        fall_bits(b->con_up, y, falls);
+        fall_bits(b->con_down, y, falls);
+        fall_bits(b->con_left, y, falls);
+        fall_bits(b->con_right, y, falls);
+
+        for (u64 bits = falls; bits; bits &= bits - 1) {
+            int x = __builtin_ctzll(bits);
+            b->letters[(y + 1) * b->width + x] = b->letters[y * b->width + x];
+            b->letters[y * b->width + x] = '\0';
+            b->hash ^= cell_key(b, x, y + 1);
+        }
+
+        b->dirty_rows |= 3ull << y;
+        b->dirty_cols |= falls;
+        updated = true;
+    }
+
+    return updated;
+}
+
+// move the tile at (x, y) down to the empty cell (x, ny)
+static void board_drop_cell(struct board *b, int x, int y, int ny) {
+    u64 *masks[] = { b->filled, b->greyed, b->marked, b->con_up, b->con_down, b->con_left, b->con_right };
+    u64 bit = 1ull << x;
+
+    b->hash ^= cell_key(b, x, y);
+
+    for (int i = 0; i < sizeof(masks) / sizeof(masks[0]); i++) {
+        masks[i][ny] |= masks[i][y] & bit;
+        masks[i][y] &= ~bit;
+    }
+
+    b->letters[ny * b->width + x] = b->letters[y * b->width + x];
+    b->letters[y * b->width + x] = '\0';
+
+    b->hash ^= cell_key(b, x, ny);
+
+    b->dirty_rows |= (1ull << y) | (1ull << ny);
+    b->dirty_cols |= bit;
+}
+
+bool board_settle(struct board *b, u8 *drop) {
+    bool updated = false;
+
+    // floor[x] is the highest occupied row below the row being settled
+    u8 floor[GRID_MAX_DIM];
+    for (int x = 0; x < b->width; x++) {
+        floor[x] = b->height;
+    }
+
+    if (drop) {
+        memset(drop, 0, b->width * b->height);
+    }
+
+    // Bottom up, everything below the current row is already at rest, so a
+    // tile lands right above its column's floor and becomes the new floor.
+    for (int y = (int)b->height - 1; y >= 0; y--) {
+        // left halves of horizontal pairs, their partner is the next bit up
+        u64 pairs = b->con_right[y] & (b->con_left[y] >> 1);
+
+        for (u64 bits = b->filled[y]; bits; bits &= bits - 1) {
+            int x = __builtin_ctzll(bits);
+            bool pair = (pairs >> x) & 1;
+            int rest = floor[x] - 1;
+
+            if (pair) {
+                // the right half is handled here as well
+                bits &= ~(2ull << x);
+                rest = (floor[x] < floor[x + 1] ? floor[x] : floor[x + 1]) - 1;
+            }
+
+            if (board_greyed(b, x, y) || (pair && board_greyed(b, x + 1, y))) {
+                rest = y;
+            }
+
+            for (int i = 0; i <= pair; i++) {
+                if (rest != y) {
+                    board_drop_cell(b, x + i, y, rest);
+                    if (drop) drop[rest * b->width + x + i] = rest - y;
+                    updated = true;
+                }
+                floor[x + i] = rest;
+            }
+        }
+    }
+
+    return updated;
+}
+
+// Longest word along the len cells from (x, y) in steps of (dx, dy). The
+// line is looked up in cache by its packed letters first, and only spelled
+// out for the trie if it isn't there.
+static bool line_longest_word(const struct board *b, struct dict_trie *dict, struct line_cache *cache, int x, int y,
+                              int dx, int dy, int len, int max_len, int *start, int *end) {
+    // most lines lack three tiles in a row, find out before packing letters
+    u64 filled = 0;
+    if (dy == 0) {
+        filled = (b->filled[y] >> x) & span_mask(0, len);
+    } else {
+        for (int i = 0, cx = x, cy = y; i < len; i++, cx += dx, cy += dy) {
+            filled |= ((b->filled[cy] >> cx) & 1) << i;
+        }
+    }
+
+    if (!trie_line_may_hold_word(filled, max_len)) {
+        return false;
+    }
+
+    u64 codes = 0;
+    u64 cells = 0;
+
+    for (int i = 0, cx = x, cy = y; i < len; i++, cx += dx, cy += dy) {
+        if (!((filled >> i) & 1)) {
+            continue;
+        }
+
+        u64 code = trie_line_code(board_letter(b, cx, cy) | 0x20);
+        if (i < LINE_CACHE_MAX_LEN) codes |= code << (5 * i);
+        cells |= (u64)(code != 0) << i;
+    }
+
+    if (!trie_line_may_hold_word(cells, max_len)) {
+        return false;
+    }
+
+    bool cached = cache && len <= LINE_CACHE_MAX_LEN;
+    u64 key = trie_line_key(codes, max_len);
+    bool found;
+    if (cached && line_cache_lookup(cache, key, &found, start, end)) {
+        return found;
+    }
+
+    char letters[GRID_MAX_DIM + 1];
+    for (int i = 0, cx = x, cy = y; i < len; i++, cx += dx, cy += dy) {
+        letters[i] = ((b->filled[cy] >> cx) & 1) ? tolower(board_letter(b, cx, cy)) : ' ';
+    }
+    letters[len] = '\0';
+
+    found = trie_longest_word(dict, letters, len, max_len, start, end);
+    if (cached) {
+        line_cache_store(cache, key, found, found ? *start : 0, found ? *end : 0);
+    }
+
+    return found;
+}
+
+// Only rows and columns changed since their last scan can hold a new word,
+// an unchanged line either had nothing or had its word cleared (and got dirty).
+bool board_scan_for_words(struct board *b, struct dict_trie *dict, struct line_cache *cache) {
+    bool found_word = false;
+    int start, end;
+
+    b->found_count = 0;
+
+    // words are capped at the board height in both directions
+    int max_len_col = b->height;
+    int max_len_row = b->width < b->height ? b->width : b->height;
+
+    // Vertical check
+    for (int x = 0; x < b->width; x++) {
+        if (!(b->dirty_cols & (1ull << x))) {
+            continue;
+        }
+
+        if (line_longest_word(b, dict, cache, x, 0, 0, 1, b->height, max_len_col, &start, &end)) {
+            for (int y = start; y < end; y++) {
+                b->marked[y] |= 1ull << x;
+            }
+            b->found[b->found_count++] = end - start;
+            found_word = true;
+        }
+    }
+    b->dirty_cols = 0;
+
+    // Horizontal check
+    for (int y = 0; y < b->height; y++) {
+        if (!(b->dirty_rows & (1ull << y))) {
+            continue;
+        }
+
+        if (line_longest_word(b, dict, cache, 0, y, 1, 0, b->width, max_len_row, &start, &end)) {
+            b->marked[y] |= span_mask(start, end);
+            b->found[b->found_count++] = end - start;
+            found_word = true;
+        }
+    }
+    b->dirty_rows = 0;
+
+    return found_word;
+}
+
+bool board_lines_hold_word(const struct board *b, struct dict_trie *dict, struct line_cache *cache, u64 rows, u64 cols) {
+    int start, end;
+    int max_len_col = b->height;
+    int max_len_row = b->width < b->height ? b->width : b->height;
+
+    for (int x = 0; x < b->width; x++) {
+        if ((cols & (1ull << x)) && line_longest_word(b, dict, cache, x, 0, 0, 1, b->height, max_len_col, &start, &end)) {
+            return true;
+        }
+    }
+
+    for (int y = 0; y < b->height; y++) {
+        if ((rows & (1ull << y)) && line_longest_word(b, dict, cache, 0, y, 1, 0, b->width, max_len_row, &start, &end)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool board_run_holds_word(const struct board *b, struct dict_trie *dict, struct line_cache *cache, int x, int y, bool column) {
+    int start, end;
+
+    if (column) {
+        int top = y, bottom = y + 1;
+        while (top > 0 && board_filled(b, x, top - 1)) top--;
+        while (bottom < (int)b->height && board_filled(b, x, bottom)) bottom++;
+
+        return bottom - top >= 3 && line_longest_word(b, dict, cache, x, top, 0, 1, bottom - top, b->height, &start, &end);
+    }
+
+    // the tiles either side of x up to the first gap, x itself is filled
+    u64 row = b->filled[y];
+    int left = x + 1 - __builtin_clzll(~(row << (63 - x)));
+    int right = x + __builtin_ctzll(~(row >> x));
+    int max_len = b->width < b->height ? b->width : b->height;
+
+    return right - left >= 3 && line_longest_word(b, dict, cache, left, y, 1, 0, right - left, max_len, &start, &end);
+}
+
+bool board_clear_marked(struct board *b) {
+    bool cleared = false;
+
+    for (int y = 0; y < b->height; y++) {
+        u64 marked = b->marked[y] & b->filled[y];
+        if (!marked) {
+            continue;
+        }
+
+        for (u64 bits = marked; bits; bits &= bits - 1) {
+            board_clear_cell(b, __builtin_ctzll(bits), y);
+        }
+        cleared = true;
+    }
+
+    return cleared;
+}
@@ -0,0 +1,399 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/game.h"
+#include "../include/alloc.h"
+#include "../include/macros.h"
+#include "../include/profile.h"
+
+static bool check_tile_in_grid(const struct board *b, struct game_tile t, vec2i move) {
+    vec2i dest = vector_add(t.pos, move);
+    return (dest.x < b->width &&
+            dest.x >= 0 &&
+            dest.y < b->height &&
+            dest.y >= 0);
+}
+
+static bool check_tile_move(const struct board *b, struct game_tile t, vec2i move) {
+    return !board_filled(b, t.pos.x + move.x, t.pos.y + move.y);
+}
+
+static void player_move(struct game *g, vec2i move) {
+    g->player.t1.pos = vector_add(g->player.t1.pos, move);
+    g->player.t2.pos = vector_add(g->player.t2.pos, move);
+}
+
+bool game_pair_can_move(const struct board *b, const struct game_tile *t1, const struct game_tile *t2, vec2i move) {
+    return check_tile_in_grid(b, *t1, move) && check_tile_in_grid(b, *t2, move) &&
+           check_tile_move(b, *t1, move) && check_tile_move(b, *t2, move);
+}
+
+bool game_player_can_move(const struct game *g, vec2i move) {
+    return g->player.active && game_pair_can_move(&g->board, &g->player.t1, &g->player.t2, move);
+}
+
+static void player_set(struct game *g) {
+    struct game_tile t1 = g->player.t1;
+    struct game_tile t2 = g->player.t2;
+
+    board_set(&g->board, t1.pos.x, t1.pos.y, t1.letter, false, t1.connected);
+    board_set(&g->board, t2.pos.x, t2.pos.y, t2.letter, false, t2.connected);
+
+    g->events |= GAME_EVENT_SET;
+}
+
+static void player_clear(struct game *g) {
+    g->player.t1 = (struct game_tile){.letter = '\0', .connected = CON_NONE, .pos = {-1, -1}};
+    g->player.t2 = (struct game_tile){.letter = '\0', .connected = CON_NONE, .pos = {-1, -1}};
+}
+
+static void stop_player(struct game *g) {
+    player_set(g);
+    IFDEBUG_LOG("Player set");
+    player_clear(g);
+    IFDEBUG_LOG("Cleared player");
+
+    g->status = SCANNING;
+
+    g->player.active = false;
+}
+
+static bool grid_scan_for_words(struct game *g) {
+    PROFILE_SCOPE(PROFILE_SCAN);
+    bool marked = false;
+
+    // scanning runs after every landing and settle, it must stay off the heap
+    ALLOC_CHECKPOINT(allocs);
+
+    marked = board_scan_for_words(&g->board, g->dict, g->lines);
+
+    ASSERT_NO_ALLOC_SINCE(allocs);
+
+    return marked;
+}
+
+static void grid_randomize_grey_tiles(struct game *g) {
+    struct board *b = &g->board;
+    int count = 0;
+    for (int i = b->width * 7; i < b->width * b->height; i++) {
+        if (i > rng_below(&g->rng, 240) && count < 10) {
+            board_set(b, i % b->width, i / b->width, lpool_random_letter(&g->letter_pool, &g->rng), true, CON_NONE);
+            count++;
+        }
+    }
+}
+
+static void queue_enqueue(struct game *g) {
+    char letters[2];
+    lpool_fill(&g->letter_pool, &g->rng, letters, 2);
+
+    g->queue[0] = (struct game_tile){.letter = letters[0], .connected = CON_NONE, .pos = {-1, -1}};
+    g->queue[1] = (struct game_tile){.letter = letters[1], .connected = CON_NONE, .pos = {-1, -1}};
+    IFDEBUG_LOG("Enqueued two tiles");
+}
+
+bool game_pair_spawn(const struct board *b, struct game_tile *t1, struct game_tile *t2) {
+    t1->pos = (vec2i){(b->width / 2) - 1, 0};
+    t2->pos = (vec2i){(b->width / 2), 0};
+
+    t1->connected = CON_RIGHT;
+    t2->connected = CON_LEFT;
+
+    u64 spawn_mask = (1ull << t1->pos.x) | (1ull << t2->pos.x);
+    return !board_row_blocked(b, 0, spawn_mask);
+}
+
+// true if successful, false otherwise
+static bool spawn_player(struct game *g) {
+    g->player.t1 = g->queue[0];
+    g->player.t2 = g->queue[1];
+
+    g->player.active = true;
+
+    IFDEBUG_LOG("Spawned player");
+    if (!game_pair_spawn(&g->board, &g->player.t1, &g->player.t2)) {
+        g->status = QUIT;
+        return false;
+    }
+
+    return true;
+}
+
+static bool update_world_physics(struct game *g) {
+    PROFILE_SCOPE(PROFILE_PHYSICS);
+
+    if (g->gravity == GRAVITY_SETTLE) {
+        // the whole cascade lands now, front ends animate it from g->fall
+        return board_settle(&g->board, g->fall);
+    }
+
+    return board_fall_step(&g->board);
+}
+
+static bool update_player_physics(struct game *g) {
+    vec2i fall = {0, 1};
+    if (game_player_can_move(g, fall)) {
+        player_move(g, fall);
+        return true;
+    } else {
+        stop_player(g);
+    }
+    return false;
+}
+
+void game_init(struct game *g, struct dict_trie *dict, u32 cols, u32 rows, u64 seed) {
+    memset(g, 0, sizeof(*g));
+    g->dict = dict;
+    g->gravity = GRAVITY_STEP;
+    g->status = PLAYING;
+
+    g->seed = seed;
+    rng_seed(&g->rng, seed);
+
+    board_init(&g->board, cols, rows);
+
+    lpool_init(&g->letter_pool);
+    lpool_populate(&g->letter_pool);
+
+    grid_randomize_grey_tiles(g);
+
+    queue_enqueue(g);
+    spawn_player(g);
+    queue_enqueue(g);
+}
+
+void game_destroy(struct game *g) {
+    lpool_destroy(&g->letter_pool);
+}
+
+void game_update(struct game *g) {
+    PROFILE_SCOPE(PROFILE_UPDATE);
+
+    board_update_connections(&g->board);
+
+    // Scan for words only if not already scanned
+    if (g->status == SCANNING) {
+        if (grid_scan_for_words(g)) {
+            g->status = CLEARING;
+            return;
+        }
+    } else if (g->status == CLEARING) {
+        // Clear the board of marked files
+        board_clear_marked(&g->board);
+        board_update_connections(&g->board);
+
+        g->status = HALT;
+
+        return;
+    }
+
+    if (g->status != PLAYING) {
+        // Drop falling tiles every tick until they can't fall anymore
+        g->status = update_world_physics(g) ? HALT : PLAYING;
+        if (g->status != HALT) {
+            if (grid_scan_for_words(g)) {
+                g->status = CLEARING;
+
+                return;
+            }
+
+            spawn_player(g);
+            queue_enqueue(g);
+        }
+    } else {
+        update_player_physics(g);
+    }
+}
+
+double game_tick_length(const struct game *g) {
+    // varying tick speeds --> larger = slower
+    switch (g->status) {
+        case (HALT):
+            return 250;
+        case (CLEARING):
+            return 250;
+        case (SCANNING):
+            return 100;
+        case (PLAYING):
+            return 1500;
+        default:
+            return 10;
+    }
+}
+
+bool game_step(struct game *g, double now) {
+    g->tick = game_tick_length(g);
+
+    if (now >= g->time + g->tick) {
+        g->time = now;
+
+        game_update(g);
+        return true;
+    }
+
+    return false;
+}
+
+void game_player_shift(struct game *g, int dx) {
+    vec2i move = (vec2i){dx, 0};
+    if (game_player_can_move(g, move))
+        player_move(g, move);
+}
+
+void game_player_drop(struct game *g, double now) {
+    if (g->status != PLAYING || !g->player.active) {
+        return;
+    }
+
+    vec2i move = (vec2i){0, 1};
+    if (game_player_can_move(g, move)) {
+        g->time = now;
+        player_move(g, move);
+    }
+    else {
+        stop_player(g);
+    }
+}
+
+void game_player_flip(struct game *g) {
+    u8 letter = g->player.t1.letter;
+    g->player.t1.letter = g->player.t2.letter;
+    g->player.t2.letter = letter;
+}
+
+bool game_pair_rotate_cw(const struct board *b, struct game_tile *t1, struct game_tile *t2) {
+    vec2i t1pos = t1->pos;
+    vec2i t2pos = t2->pos;
+
+    short t1con = t1->connected;
+    short t2con = t2->connected;
+
+    if (t1pos.x < t2pos.x) {
+        t1pos.y -= 1;
+        t2pos.x -= 1;
+        t1con = CON_DOWN;
+        t2con = CON_UP;
+    } else if (t1pos.x == t2pos.x && t1pos.y < t2pos.y) {
+        t1pos.y += 1;
+        t1pos.x += 1;
+        t1con = CON_LEFT;
+        t2con = CON_RIGHT;
+    } else if (t1pos.x > t2pos.x && t1pos.y == t2pos.y) {
+        t1pos.x -= 1;
+        t2pos.y -= 1;
+        t1con = CON_UP;
+        t2con = CON_DOWN;
+    } else {
+        t2pos.x += 1;
+        t2pos.y += 1;
+        t1con = CON_RIGHT;
+        t2con = CON_LEFT;
+    }
+
+    if (t1pos.y < 0 || t2pos.y < 0) {
+        return false;
+    }
+
+    bool kick_check =
+        (board_filled(b, t2pos.x, t2pos.y) &&
+        !board_filled(b, t2pos.x - 1, t2pos.y)) || (t1pos.x >= b->width) || (t2pos.x >= b->width) ||
+        (board_filled(b, t1pos.x, t1pos.y) &&
+        !board_filled(b, t1pos.x - 1, t1pos.y));
+
+    if (kick_check) {
+        t1pos.x -= 1;
+        t2pos.x -= 1;
+    }
+
+    bool t1_check = (board_filled(b, t1pos.x, t1pos.y) || t1pos.x < 0 || t1pos.x >= b->width);
+    bool t2_check = (board_filled(b, t2pos.x, t2pos.y) || t2pos.x < 0 || t2pos.x >= b->width);
+
+    if (t1_check || t2_check) {
+        return false;
+    }
+
+    t1->pos = t1pos;
+    t2->pos = t2pos;
+
+    t1->connected = t1con;
+    t2->connected = t2con;
+
+    return true;
+}
+
+void game_player_rotate_cw(struct game *g) {
+    if (g->player.active && game_pair_rotate_cw(&g->board, &g->player.t1, &g->player.t2)) {
+        IFDEBUG_LOG("Rotated cw");
+    }
+}
+
+bool game_pair_rotate_ccw(const struct board *b, struct game_tile *t1, struct game_tile *t2) {
+    vec2i t1pos = t1->pos;
+    vec2i t2pos = t2->pos;
+
+    short t1con = t1->connected;
+    short t2con = t2->connected;
+
+    if (t1pos.x < t2pos.x) {
+        t1pos.x += 1;
+        t2pos.y -= 1;
+        t1con = CON_UP;
+        t2con = CON_DOWN;
+    } else if (t1pos.x == t2pos.x && t1pos.y > t2pos.y) {
+        t2pos.x -= 1;
+        t2pos.y += 1;
+        t1con = CON_LEFT;
+        t2con = CON_RIGHT;
+    } else if (t1pos.x > t2pos.x && t1pos.y == t2pos.y) {
+        t2pos.x += 1;
+        t1pos.y -= 1;
+        t1con = CON_DOWN;
+        t2con = CON_UP;
+    } else {
+        t1pos.y += 1;
+        t1pos.x -= 1;
+        t1con = CON_RIGHT;
+        t2con = CON_LEFT;
+    }
+
+    if (t1pos.y < 0 || t2pos.y < 0) {
+        return false;
+    }
+
+    bool kick_check =
+        (board_filled(b, t2pos.x, t2pos.y) &&
+        !board_filled(b, t2pos.x + 1, t2pos.y)) || (t1pos.x < 0) || (t2pos.x < 0) ||
+        (board_filled(b, t1pos.x, t1pos.y) &&
+        !board_filled(b, t1pos.x + 1, t1pos.y));
+
+    if (kick_check) {
+        t1pos.x += 1;
+        t2pos.x += 1;
+    }
+
+    bool t1_move_failed =
+        (board_filled(b, t1pos.x, t1pos.y) ||
+        t1pos.x < 0 || t1pos.x >= b->width);
+    bool t2_move_failed =
+        (board_filled(b, t2pos.x, t2pos.y) ||
+        t2pos.x < 0 || t2pos.x >= b->width);
+
+    if (t1_move_failed || t2_move_failed) {
+        return false;
+    }
+
+    t1->pos = t1pos;
+    t2->pos = t2pos;
+
+    t1->connected = t1con;
+    t2->connected = t2con;
+
+    return true;
+}
+
+void game_player_rotate_ccw(struct game *g) {
+    if (g->player.active && game_pair_rotate_ccw(&g->board, &g->player.t1, &g->player.t2)) {
+        IFDEBUG_LOG("Rotated ccw");
+    }
+}
@@ -1,31 +1,81 @@
 #include <stdio.h>
 #include <stdlib.h>
-#include <time.h>
+#include <string.h>
 
 #include "../include/lpool.h"
+#include "../include/macros.h"
 
 void lpool_init(struct letter_pool* pool) {
-    pool->head = NULL;
+    pool->count = 0;
     pool->totalWeight = 0;
+    pool->dirty = true;
 }
 
 void lpool_add_letter(struct letter_pool* pool, char letter, int weight) {
-    struct letter_node* newNode = (struct letter_node*)malloc(sizeof(struct letter_node));
-    newNode->letter = letter;
-    newNode->weight = weight;
-    newNode->next = NULL;
-
-    if (pool->head == NULL) {
-        pool->head = newNode;
-    } else {
-        struct letter_node* current = pool->head;
-        while (current->next != NULL) {
-            current = current->next;
+    ASSERT(weight > 0, "letter %c needs a positive weight\n", letter);
+
+    u32 i = 0;
+    while (i < pool->count && pool->letters[i] != letter) {
+        i++;
+    }
+
+    if (i == pool->count) {
+        ASSERT(pool->count < LPOOL_MAX_LETTERS, "letter pool is full\n");
+        pool->letters[i] = letter;
+        pool->weights[i] = 0;
+        pool->count++;
+    }
+
+    pool->totalWeight += weight - pool->weights[i];
+    pool->weights[i] = weight;
+    pool->dirty = true;
+}
+
+// Vose's method in integers: column i is worth weights[i] * count out of
+// count * totalWeight, so every column ends up holding exactly totalWeight.
+static void lpool_build_alias(struct letter_pool* pool) {
+    u32 n = pool->count;
+    u64 scaled[LPOOL_MAX_LETTERS];
+    u8 small[LPOOL_MAX_LETTERS], large[LPOOL_MAX_LETTERS];
+    u32 small_count = 0, large_count = 0;
+
+    for (u32 i = 0; i < n; i++) {
+        scaled[i] = (u64)pool->weights[i] * n;
+        if (scaled[i] < (u64)pool->totalWeight) {
+            small[small_count++] = i;
+        } else {
+            large[large_count++] = i;
         }
-        current->next = newNode;
     }
 
-    pool->totalWeight += weight;
+    while (small_count > 0 && large_count > 0) {
+        u8 s = small[--small_count];
+        u8 l = large[--large_count];
+
+        pool->prob[s] = scaled[s];
+        pool->alias[s] = l;
+
+        scaled[l] -= pool->totalWeight - scaled[s];
+        if (scaled[l] < (u64)pool->totalWeight) {
+            small[small_count++] = l;
+        } else {
+            large[large_count++] = l;
+        }
+    }
+
+    // whatever is left is full to the brim
+    while (large_count > 0) {
+        u8 l = large[--large_count];
+        pool->prob[l] = pool->totalWeight;
+        pool->alias[l] = l;
+    }
+    while (small_count > 0) {
+        u8 s = small[--small_count];
+        pool->prob[s] = pool->totalWeight;
+        pool->alias[s] = s;
+    }
+
+    pool->dirty = false;
 }
 
 void lpool_populate(struct letter_pool* pool) {
@@ -57,30 +107,39 @@ void lpool_populate(struct letter_pool* pool) {
     lpool_add_letter(pool, 'Z', 1);
 }
 
-char lpool_random_letter(struct letter_pool* pool) {
-    int randomWeight = rand() % pool->totalWeight;
-    struct letter_node* current = pool->head;
+static inline char lpool_draw(const struct letter_pool* pool, struct rng* rng) {
+    u32 column = rng_below(rng, pool->count);
+    if (rng_below(rng, pool->totalWeight) < pool->prob[column]) {
+        return pool->letters[column];
+    }
+    return pool->letters[pool->alias[column]];
+}
 
-    while (current != NULL) {
-        randomWeight -= current->weight;
-        if (randomWeight < 0) {
-            return current->letter;
-        }
-        current = current->next;
+char lpool_random_letter(struct letter_pool* pool, struct rng* rng) {
+    if (pool->count == 0) {
+        return '\0';
+    }
+    if (pool->dirty) {
+        lpool_build_alias(pool);
     }
 
-    // This should not be reached under normal circumstances
-    return '\0';
+    return lpool_draw(pool, rng);
 }
 
-void lpool_destroy(struct letter_pool* pool) {
-    struct letter_node* current = pool->head;
-    while (current != NULL) {
-        struct letter_node* next = current->next;
-        free(current);
-        current = next;
+void lpool_fill(struct letter_pool* pool, struct rng* rng, char* out, usize count) {
+    if (pool->count == 0) {
+        memset(out, '\0', count);
+        return;
+    }
+    if (pool->dirty) {
+        lpool_build_alias(pool);
+    }
+
+    for (usize i = 0; i < count; i++) {
+        out[i] = lpool_draw(pool, rng);
     }
-    pool->head = NULL;
-    pool->totalWeight = 0;
 }
 
+void lpool_destroy(struct letter_pool* pool) {
+    lpool_init(pool);
+}
@@ -1,6 +1,8 @@
 #include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
 
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_image.h>
@@ -8,173 +10,93 @@
 #include <time.h>
 
 #include "../include/macros.h"
+#include "../include/alloc.h"
+#include "../include/assets.h"
 #include "../include/types.h"
 #include "../include/trie.h"
-#include "../include/lpool.h"
+#include "../include/game.h"
+#include "../include/sim.h"
+#include "../include/stats.h"
+#include "../include/pixel.h"
+#include "../include/profile.h"
 #include "../include/render.h"
+#include "../include/scene.h"
 
 struct {
     SDL_Window *window;
     SDL_Texture *texture;
     SDL_Renderer *renderer;
 
-    struct dict_trie_node *dict_trie;
-    struct letter_pool letter_pool;
+    struct dict_trie *dict_trie;
+    // the scans' line cache, used by whichever thread updates the game
+    struct line_cache lines;
+    struct game game;
+
+    // state.game is only touched through state.sim, which may run it on
+    // sim_thread; drawing reads the latest snapshot, state.view
+    struct sim sim;
+    SDL_Thread *sim_thread;
+    const struct sim_snapshot *view;
+    // simulation time the frame is drawn at
+    double view_clock;
 
     vec2i mouse_pos;
-    u32 pixels[SCREEN_WIDTH * SCREEN_HEIGHT];
+    // the draw list of the frame, and the screen the software path composes
+    struct scene scene;
+
+    // RENDER_SOFTWARE composes state.scene.screen and uploads it, RENDER_ATLAS
+    // draws quads from a texture atlas uploaded once at startup
     enum {
-        QUIT,
-        HALT,
-        PAUSED,
-        GAMEOVER,
-        CLEARING,
-        PLAYING,
-        SCANNING,
-    } status;
-
-    double time;
-    double tick;
+        RENDER_SOFTWARE,
+        RENDER_ATLAS,
+    } backend;
+    struct atlas atlas;
+    struct render_batch batch;
 } state;
 
-struct {
-    Mix_Chunk* set;
-    Mix_Chunk* move;
-} sounds;
-
-struct grid {
-    uint height, width;
-
-    obj_info_t obj;
-    tile_t *tiles;
-} grid;
+// --latency: time from each key press to the return of the present that first
+// shows its effect, which with vsync is when the frame starts scanning out
+#define LATENCY_PENDING (SIM_COMMAND_CAPACITY * 4)
+// samples reserved up front, over an hour of steady play, so drawing frames
+// doesn't reallocate them
+#define LATENCY_RESERVE (1 << 16)
 
 struct {
-    tile_t tiles[2];
-
-    obj_info_t obj;
-} queue;
+    bool enabled;
+    // commands pushed and commands whose frame has been accounted for
+    u32 pushed;
+    u32 shown;
+    double pressed[LATENCY_PENDING];
+    struct samples samples;
+} latency;
 
 struct {
-    bool active;
-    tile_t t1, t2;
-} player;
-
-u32 *shrink_sprite(sprite *sp, uint factor) {
-    if (sp->width == 0 || sp->height == 0) {
-        return NULL; // Handle invalid input
-    }
-
-    uint w = sp->width / factor; // Round up the result
-    uint h = sp->height / factor;
-
-    u32 *pix = malloc(sizeof(u32) * w * h);
-
-    if (pix == NULL) {
-        return NULL; // Handle memory allocation failure
-    }
-
-    for (int i = 0, j = 0; i < (sp->width * sp->height) - (sp->width + factor) && j < (w * h); i += factor, j++) {
-        u32 quad[4];
-        quad[0] = sp->pixels[i];
-        quad[1] = sp->pixels[i + 1];
-        quad[2] = sp->pixels[i + sp->width];
-        quad[3] = sp->pixels[i + sp->width + 1];
-
-        u8 avg_alpha = ((quad[0] >> 24 & 0xFF) +
-                       ((quad[1] >> 24) & 0xFF) +
-                       ((quad[2] >> 24) & 0xFF) + 
-                       ((quad[3] >> 24) & 0xFF)) / 4;
-
-        u8 avg_blue =  ((quad[0] >> 16 & 0xFF) +
-                       ((quad[1] >> 16) & 0xFF) +
-                       ((quad[2] >> 16) & 0xFF) + 
-                       ((quad[3] >> 16) & 0xFF)) / 4;
-
-        u8 avg_green = ((quad[0] >> 8 & 0xFF) +
-                       ((quad[1] >> 8) & 0xFF) +
-                       ((quad[2] >> 8) & 0xFF) + 
-                       ((quad[3] >> 8) & 0xFF)) / 4;
-
-        u8 avg_red =   ((quad[0] & 0xFF) +
-                       (quad[1] & 0xFF) +
-                       (quad[2] & 0xFF) + 
-                       (quad[3] & 0xFF)) / 4;
-
-        pix[j] = (avg_alpha << 24) + (avg_blue << 16) + (avg_green << 8) + avg_red;
-
-        if (i % sp->width == 0) i += sp->width;
-    }
+    Mix_Chunk* set;
+    Mix_Chunk* move;
+} sounds;
 
-    return pix;
-}
+static struct assets assets;
 
-u32 *load_img_pixels(const char *file) {
-    SDL_Surface *surface = IMG_Load(file);
-    u32 *pixels;
-    if (surface) {
-        LOG("Loading %s", file);
-        pixels = surface->pixels;
-        SDL_FreeSurface(surface);
-    }
-    return pixels;
+static void load_sprites() {
+    ASSERT(assets_load(&assets, "./sprites.bin") == 0, "unable to load the sprites\n");
 }
 
-static const char* letter_textures[] = {
-    "gfx/TileA.png", "gfx/TileB.png", "gfx/TileC.png", "gfx/TileD.png",
-    "gfx/TileE.png", "gfx/TileF.png", "gfx/TileG.png", "gfx/TileH.png",
-    "gfx/TileI.png", "gfx/TileJ.png", "gfx/TileK.png", "gfx/TileL.png",
-    "gfx/TileM.png", "gfx/TileN.png", "gfx/TileO.png", "gfx/TileP.png",
-    "gfx/TileQ.png", "gfx/TileR.png", "gfx/TileS.png", "gfx/TileT.png",
-    "gfx/TileU.png", "gfx/TileV.png", "gfx/TileW.png", "gfx/TileX.png",
-    "gfx/TileY.png", "gfx/TileZ.png",
-};
-
-static sprite sprites[27];
-
-static void load_sprites() {
+static bool load_atlas() {
+    sprite *atlas_sprites[ATLAS_QUEUE_BORDER + 1];
     for (int i = 0; i < 26; i++) {
-        sprites[i] = sprite_create_from(64, 64, load_img_pixels(letter_textures[i]));
+        for (int v = 0; v < TILE_VARIANT_COUNT; v++) {
+            atlas_sprites[ATLAS_TILE(i, v)] = &state.scene.tile_variants[i][v];
+        }
     }
-    LOG("Create sprite");
-    sprites[26] = sprite_create_from(64 * 3, 64 * 2, load_img_pixels("gfx/QueueBorder.png"));
-}
-
-static void queue_render() {
-    u32 x = queue.obj.pos.x;
-    u32 y = queue.obj.pos.y;
-
-    // border
-    sprite_render(x, y, queue.obj.sprite, state.texture);
-
-    // tiles
-    int gap_x = queue.tiles[0].obj.size.x / 2;
-    int gap_y = queue.tiles[0].obj.size.y / 2;
+    atlas_sprites[ATLAS_QUEUE_BORDER] = &assets.sprites[ASSET_QUEUE_BORDER];
 
-    sprite_render(x + gap_x, y + gap_y, queue.tiles[0].obj.sprite, state.texture);
-    sprite_render(x + gap_x * 3, y + gap_y, queue.tiles[1].obj.sprite, state.texture);
+    return atlas_create(&state.atlas, state.renderer, atlas_sprites, ATLAS_QUEUE_BORDER + 1);
 }
 
-
 static int pix_pos_to_grid_index(vec2i world_pos) {
-    vec2i grid_pos = {.x = ((world_pos.x - grid.obj.pos.x) / TILE_SIZE), .y = (world_pos.y - grid.obj.pos.y) / TILE_SIZE};
-    return (grid_pos.y * grid.width) + grid_pos.x;
-}
-
-static u32 at(uint y, uint x, u32 width) {
-    return (y * width) + x;
-}
-
-static tile_t *tile_create_empty() {
-    IFDEBUG_LOG("Created default tile");
-    return &(tile_t){
-        .letter='\0',
-        .marked=false,
-        .filled=false,
-        .connected=CON_NONE,
-        .pos={-1, -1},
-        .obj={},
-    };
+    const struct scene *s = &state.scene;
+    vec2i grid_pos = {.x = ((world_pos.x - s->grid.pos.x) / TILE_SIZE), .y = (world_pos.y - s->grid.pos.y) / TILE_SIZE};
+    return (grid_pos.y * s->cols) + grid_pos.x;
 }
 
 /*
@@ -182,689 +104,242 @@ static tile_t *tile_create_empty() {
  DRAWING
 
 */
-static void clear_pixel_buf(u32 *pix, usize size) {
-    for (int i = 0; i < size; i++) {
-        state.pixels[i] = 0x00000000;
-    }
-}
+// same picture as the software path, as one batch of quads from the atlas
+static void render_atlas() {
+    struct render_batch *batch = &state.batch;
+    const struct scene *s = &state.scene;
 
-static void tile_draw(tile_t t) {
-    u32 x = t.pos.x * t.obj.size.x + grid.obj.pos.x;
-    u32 y = t.pos.y * t.obj.size.y + grid.obj.pos.y;
-    if (t.marked) {
-        u32 *pixels = shrink_sprite(t.obj.sprite, 2);
+    SDL_SetRenderDrawColor(state.renderer, 0, 0, 0, 255);
+    SDL_RenderClear(state.renderer);
 
-        for (int i = 0; i < (t.obj.sprite->width / 2) * (t.obj.sprite->height / 2); i++) {
-            pixels[i] = lighten(pixels[i]);
-        }
+    batch_begin(batch, state.renderer, &state.atlas);
 
-        pix_buf_render(x + 16, y + 16, t.obj.sprite->width / 2, t.obj.sprite->height / 2, pixels, state.texture);
+    // background and grid lines, flattened over black like the software path
+    {
+        PROFILE_SCOPE(PROFILE_DRAW_BG);
+        batch_fill(batch, 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT, flatten(BG_COLOR));
     }
-    else if (t.greyed) {
-        u32 *pixels = clone_pixels(t.obj.sprite->pixels, t.obj.sprite->width * t.obj.sprite->height);
 
-        for (int i = 0; i < t.obj.sprite->width * t.obj.sprite->height; i++) {
-            pixels[i] = greyscale(pixels[i]);
+    {
+        PROFILE_SCOPE(PROFILE_DRAW_GRID);
+        int gx = s->grid.pos.x;
+        int gy = s->grid.pos.y;
+        for (int i = 0; i < s->cols + 1; i++) {
+            batch_fill(batch, gx + i * TILE_SIZE, gy, 1, s->rows * TILE_SIZE + 1, flatten(GRID_LINE_COLOR));
         }
-
-        pix_buf_render(x, y, t.obj.sprite->width, t.obj.sprite->height, pixels, state.texture);
-
-    } else {
-
-        u32 *pixels = clone_pixels(t.obj.sprite->pixels, t.obj.sprite->width * t.obj.sprite->height);
-
-        int border = 3;
-        u32 base_color = pixels[t.obj.sprite->width * border + border];
-        if (t.connected == CON_RIGHT) {
-            uint three_rows = (t.obj.sprite->width * 3);
-            for (int i = three_rows + t.obj.sprite->width - 3; i < (t.obj.sprite->width * t.obj.sprite->height) - three_rows; i += t.obj.sprite->width) {
-                pixels[i] = (pixels[i - 3]);
-                pixels[i+1] = (pixels[i - 3]);
-                pixels[i+2] = (pixels[i - 3]);
-            }
-        } else if (t.connected == CON_LEFT) {
-            uint three_rows = (t.obj.sprite->width * 3);
-            for (int i = three_rows; i < (t.obj.sprite->width * t.obj.sprite->height) - three_rows; i += t.obj.sprite->width) {
-                pixels[i] = (pixels[i + 3]);
-                pixels[i+1] = (pixels[i + 3]);
-                pixels[i+2] = (pixels[i + 3]);
-            }
-        } else if (t.connected == CON_UP) {
-            uint three_rows = (t.obj.sprite->width * 3);
-            for (int i = 3; i < three_rows; i++) {
-                pixels[i] = (pixels[i + three_rows]);
-                pixels[i+1] = (pixels[i + three_rows]);
-                pixels[i+2] = (pixels[i + three_rows]);
-            }
-
-        } else if (t.connected == CON_DOWN) {
-            uint three_rows = (t.obj.sprite->width * 3);
-            for (int i = (t.obj.sprite->width * t.obj.sprite->height) - three_rows; i < (t.obj.sprite->width * t.obj.sprite->height); i++) {
-                pixels[i] = (pixels[i - three_rows]);
-                pixels[i+1] = (pixels[i - three_rows]);
-                pixels[i+2] = (pixels[i - three_rows]);
-            }
+        for (int i = 0; i < s->rows + 1; i++) {
+            batch_fill(batch, gx, gy + i * TILE_SIZE, s->cols * TILE_SIZE + 1, 1, flatten(GRID_LINE_COLOR));
         }
-
-        pix_buf_render(x, y, t.obj.sprite->width, t.obj.sprite->height, pixels, state.texture);
-        // sprite_render(x, y, t.obj.sprite, state.texture);
     }
-}
 
-static void draw_tiles(tile_t *tiles, u32 count) {
-    for (int i = 0; i < count; i++)
-        if (tiles[i].filled)
-            tile_draw(tiles[i]);
-}
-
-static void draw_bg() {
-    u32 bg_color = 0xCCCCDDFF;
-    for (int i = 0; i < SCREEN_WIDTH * SCREEN_HEIGHT; i++) {
-        state.pixels[i] = bg_color;
-    }
-}
-
-static void draw_grid() {
-    u32 line_color = 0xBBBBBBBB;
-
-    int x = grid.obj.pos.x;
-    int y = grid.obj.pos.y;
-
-    for (int i = 0; i < (grid.width * TILE_SIZE) + 1; i += TILE_SIZE) {
-        verline(i + x, y, grid.height * TILE_SIZE + y, line_color, state.pixels, SCREEN_WIDTH);
-    }
-
-    for (int i = y; i < (grid.height * TILE_SIZE) + 1 + y; i += TILE_SIZE) {
-        horiline(x, (grid.width * TILE_SIZE) + x, i, line_color, state.pixels, SCREEN_WIDTH);
+    // the flush submits the whole batch, fills included
+    PROFILE_SCOPE(PROFILE_DRAW_TILES);
+    for (u32 i = 0; i < s->count; i++) {
+        const struct draw_item *item = &s->items[i];
+        if (!item->sprite) continue;
+        batch_sprite(batch, item->atlas_index, item->dst.x, item->dst.y, item->dst.w, item->dst.h);
     }
-}
-
-
-
-static void player_flip() {
-    tile_t t1 = player.t1;
-    player.t1.filled = player.t2.filled;
-    player.t1.letter = player.t2.letter;
-    player.t1.obj.sprite = player.t2.obj.sprite;
-
-    player.t2.filled = t1.filled;
-    player.t2.letter = t1.letter;
-    player.t2.obj.sprite = t1.obj.sprite;
-
-}
-
-static void player_draw() {
-    tile_draw(player.t1);
-    tile_draw(player.t2);
-}
-
-static void player_set() {
-    grid.tiles[(player.t1.pos.y * grid.width) + player.t1.pos.x] = player.t1;
-    grid.tiles[(player.t2.pos.y * grid.width) + player.t2.pos.x] = player.t2;
-    Mix_PlayChannel(-1, sounds.set, 0);
-}
-
-static void player_set_greyed() {
-    player.t1.greyed = true;
-    player.t2.greyed = true;
-    grid.tiles[(player.t1.pos.y * grid.width) + player.t1.pos.x] = player.t1;
-    grid.tiles[(player.t2.pos.y * grid.width) + player.t2.pos.x] = player.t2;
-}
-
-static void render() {
-    // clear_pixel_buf(state.pixels, SCREEN_WIDTH * SCREEN_HEIGHT);
-    draw_bg();
-    draw_grid();
-
-    SDL_SetTextureBlendMode(state.texture, SDL_BLENDMODE_BLEND);
-    SDL_UpdateTexture(state.texture, NULL, state.pixels, SCREEN_WIDTH * 4);
-
-    draw_tiles(grid.tiles, grid.width * grid.height);
-
-    queue_render();
-
-    if (player.active) player_draw();
-
-    SDL_SetTextureBlendMode(state.texture, SDL_BLENDMODE_BLEND);
-    SDL_RenderCopyEx(state.renderer, state.texture, NULL, NULL, 0.0, NULL, SDL_FLIP_NONE);
-    SDL_RenderPresent(state.renderer);
-}
 
-static bool check_tile_in_grid(tile_t t, vec2i move) {
-    vec2i dest = vector_add(t.pos, move);
-    return (dest.x < grid.width &&
-            dest.x >= 0 &&
-            dest.y < grid.height &&
-            dest.y >= 0);
+    batch_flush(batch);
 }
 
+// recomposite only the damaged regions of the screen and upload them
+static void render_software() {
+    struct scene *s = &state.scene;
 
-static bool check_tile_move(tile_t t, vec2i move) {
-
-    int g_idx = ((t.pos.y + move.y) * grid.width) + (t.pos.x + move.x);
-    if (t.filled && !(grid.tiles[g_idx].filled)) {
-        return true;
+    if (s->full) {
+        SDL_SetTextureBlendMode(state.texture, SDL_BLENDMODE_NONE);
     }
-    return false;
-}
-
-static void move_tile(tile_t *t, vec2i move) {
-    ASSERT(check_tile_move(*t, move), "couldn't move tile");
-
-    int old_idx = (t->pos.y * grid.width) + t->pos.x;
-    t->pos = vector_add(t->pos, move);
-    grid.tiles[(t->pos.y * grid.width) + t->pos.x] = *t;
-    grid.tiles[old_idx] = *tile_create_empty();
-}
-
-static bool player_within_grid_check(vec2i move) {
-    return check_tile_in_grid(player.t1, move) && check_tile_in_grid(player.t2, move);
-}
-
-static inline bool player_movement_check(vec2i move) {
-    return check_tile_move(player.t1, move) && check_tile_move(player.t2, move);
-}
-
-static void player_move(vec2i move) {
-    player.t1.pos = vector_add(player.t1.pos, move);
-    player.t2.pos = vector_add(player.t2.pos, move);
-}
-
-
-static void player_clear() {
-    player.t1 = *tile_create_empty();
-    player.t2 = *tile_create_empty();
-}
 
+    scene_composite(s);
 
-static bool grid_scan_horizontal() {
-    bool found_word = false;
-    // Horizontal check
-    for (int i = 0; i < grid.height * grid.width; i += grid.width) {
-        struct {
-            char *letters;
-            uint *indices;
-        } row;
-
-        row.letters = malloc(grid.width * sizeof(char));
-        row.indices = malloc(grid.width * sizeof(uint));
-
-        row.letters[grid.width] = '\0';
-
-        // collect row letters along with their index in the game board
-        for (int j = 0; j < grid.width; j++) {
-            if (grid.tiles[i + j].filled) {
-                row.letters[j] = tolower(grid.tiles[i+j].letter);
-            }
-            else {
-                row.letters[j] = ' ';
-            }
-            row.indices[j] = i + j;
+    {
+        PROFILE_SCOPE(PROFILE_UPLOAD);
+        for (u32 i = 0; i < s->damage.count; i++) {
+            struct rect r = s->damage.rects[i];
+            pix_buf_render_stride(r.x, r.y, r.w, r.h, &s->screen[r.y * SCREEN_WIDTH + r.x], SCREEN_WIDTH, state.texture);
         }
-        found_word = check_substrings(row.letters, row.indices, grid.tiles, grid.width, grid.height, state.dict_trie) || found_word;
-
-        free(row.letters);
-        free(row.indices);
     }
 
-    return found_word;
+    SDL_RenderCopyEx(state.renderer, state.texture, NULL, NULL, 0.0, NULL, SDL_FLIP_NONE);
 }
 
-static bool grid_scan_vertical() {
-    bool found_word = false;
-    // Vertical check
-    for (int i = 0; i < grid.width; i += 1) {
-        struct {
-            char *letters;
-            uint *indices;
-        } col;
-
-        col.letters = malloc(grid.height * sizeof(char));
-        col.indices = malloc(grid.height * sizeof(uint));
-
-        col.letters[grid.height] = '\0';
-
-        for (int j = 0; j < grid.height; j += 1) {
-            int idx = j * grid.width + i;
-
-            if (grid.tiles[idx].filled)
-                col.letters[j] = tolower(grid.tiles[idx].letter);
-            else
-                col.letters[j] = ' ';
-
-            col.indices[j] = idx;
-        }
-
+#ifdef PROFILE
+// F3 shows the timings of the last PROFILE_WINDOW frames over the picture,
+// from a texture of its own so neither backend's frame is disturbed
+#define OVERLAY_SCALE 2
+#define OVERLAY_PAD 8
+#define OVERLAY_COLUMNS 22
+#define OVERLAY_LINES (PROFILE_PHASE_COUNT + 3)
+#define OVERLAY_WIDTH (OVERLAY_COLUMNS * TEXT_ADVANCE * OVERLAY_SCALE + 2 * OVERLAY_PAD)
+#define OVERLAY_HEIGHT (OVERLAY_LINES * TEXT_LINE * OVERLAY_SCALE + 2 * OVERLAY_PAD)
+#define OVERLAY_BG 0xC0202020
+#define OVERLAY_FG 0xFFFFFFFF
+// frames between redraws, the percentiles sort the whole window
+#define OVERLAY_REFRESH 30
 
-        found_word = check_substrings(col.letters, col.indices, grid.tiles, grid.width, grid.height, state.dict_trie) || found_word;
+struct {
+    bool visible;
+    SDL_Texture *texture;
+    u32 pixels[OVERLAY_WIDTH * OVERLAY_HEIGHT];
+    // profile_frames() at the last redraw
+    u32 drawn_at;
+} overlay;
 
-        free(col.letters);
-        free(col.indices);
-    }
+static void overlay_redraw() {
+    char text[OVERLAY_COLUMNS + 1];
+    int x = OVERLAY_PAD;
+    int y = OVERLAY_PAD;
 
-    return found_word;
-}
+    pixels_fill(overlay.pixels, OVERLAY_BG, OVERLAY_WIDTH * OVERLAY_HEIGHT);
 
-// returns true if any tiles were cleared - that way we know to check for falling tiles
-static bool grid_clear_marked() {
-    bool cleared = false;
-    for (int i = 0; i < grid.width * grid.height; i++) {
-        if (grid.tiles[i].marked) {
-            cleared = true;
-            grid.tiles[i] = *tile_create_empty();
-        }
+    draw_text("phase       p50    p99", x, y, OVERLAY_SCALE, OVERLAY_FG, overlay.pixels, OVERLAY_WIDTH);
+    for (int i = 0; i < PROFILE_PHASE_COUNT; i++) {
+        y += TEXT_LINE * OVERLAY_SCALE;
+        snprintf(text, sizeof(text), "%-8s %6.2f %6.2f", profile_phase_names[i], profile_percentile(i, 50), profile_percentile(i, 99));
+        draw_text(text, x, y, OVERLAY_SCALE, OVERLAY_FG, overlay.pixels, OVERLAY_WIDTH);
     }
 
-    return cleared;
-}
-
-static bool grid_scan_for_words() {
-    bool marked = false;
+    u32 frames = profile_frames();
+    y += TEXT_LINE * OVERLAY_SCALE;
+    snprintf(text, sizeof(text), "ms over %u frames", frames < PROFILE_WINDOW ? frames : PROFILE_WINDOW);
+    draw_text(text, x, y, OVERLAY_SCALE, OVERLAY_FG, overlay.pixels, OVERLAY_WIDTH);
 
-    bool found_vert = grid_scan_vertical();
-    bool found_hori = grid_scan_horizontal();
-    marked = found_vert | found_hori;
+    u64 hits = profile_counter_sum(PROFILE_LINE_CACHE_HITS);
+    u64 lines = hits + profile_counter_sum(PROFILE_LINE_CACHE_MISSES);
+    y += TEXT_LINE * OVERLAY_SCALE;
+    snprintf(text, sizeof(text), "line cache %5.1f%% hit", lines ? 100.0 * hits / lines : 0.0);
+    draw_text(text, x, y, OVERLAY_SCALE, OVERLAY_FG, overlay.pixels, OVERLAY_WIDTH);
 
-    return marked;
+    pix_buf_render(0, 0, OVERLAY_WIDTH, OVERLAY_HEIGHT, overlay.pixels, overlay.texture);
+    overlay.drawn_at = frames;
 }
 
-
-static tile_t *tile_create(u8 letter, bool filled, bool marked, bool greyed, uint x, uint y) {
-    tile_t *t = &(tile_t){
-        .letter = letter,
-        .filled = filled,
-        .marked = marked,
-        .greyed = greyed,
-        .connected = CON_NONE,
-        .pos = {x, y},
-        .obj = (obj_info_t){
-            .sprite = &sprites[letter - 'A'],
-            .pos = {x * TILE_SIZE + grid.obj.pos.x, y * TILE_SIZE + grid.obj.pos.y},
-            .size = {TILE_SIZE, TILE_SIZE},
-        },
-    };
-
-    return t;
-}
-
-static void grid_randomize_grey_tiles() {
-    int count = 0;
-    int max = 10;
-    for (int i = grid.width * 7; i < grid.width * grid.height; i++) {
-        if (i > rand() % 240 && count < 10) {
-            grid.tiles[i] = *tile_create(lpool_random_letter(&state.letter_pool), true, false, true, i % grid.width, i / grid.width);
-            count++;
+static void overlay_toggle() {
+    if (!overlay.texture) {
+        overlay.texture = SDL_CreateTexture(state.renderer, SDL_PIXELFORMAT_ABGR8888, SDL_TEXTUREACCESS_STREAMING, OVERLAY_WIDTH, OVERLAY_HEIGHT);
+        if (!overlay.texture) {
+            LOG("Couldn't create the profiler overlay: %s", SDL_GetError());
+            return;
         }
+        SDL_SetTextureBlendMode(overlay.texture, SDL_BLENDMODE_BLEND);
     }
-}
-
-
-static void queue_enqueue() {
-    queue.tiles[0] = *tile_create(lpool_random_letter(&state.letter_pool), true, false, false, -1, -1);
-    queue.tiles[1] = *tile_create(lpool_random_letter(&state.letter_pool), true, false, false, -1, -1);
-    LOG("Enqueued two tiles");
-}
 
-// true if successful, false otherwise
-static bool spawn_player() {
-    player.t1 = queue.tiles[0];
-    player.t2 = queue.tiles[1];
-
-    player.t1.pos = (vec2i){(grid.width / 2) - 1, 0};
-    player.t2.pos = (vec2i){(grid.width / 2), 0};
-
-    player.active = true;
-
-    player.t1.connected=CON_RIGHT;
-    player.t2.connected=CON_LEFT;
-
-    LOG("Spawned player");
-    if (grid.tiles[at(player.t1.pos.y, player.t1.pos.x, grid.width)].filled ||
-        grid.tiles[at(player.t2.pos.y, player.t2.pos.x, grid.width)].filled) {
-        state.status = QUIT;
-        // state.quit = true;
-        return false;
+    overlay.visible = !overlay.visible;
+    if (overlay.visible) {
+        overlay_redraw();
     }
 
-    return true;
+    // repaint everything to show or remove it
+    state.scene.full = true;
 }
 
-static bool update_tile_connections() {
-    bool updated = false;
-    for (int i = 0; i < grid.width * grid.height; i++) {
-        if (grid.tiles[i].filled) {
-            switch(grid.tiles[i].connected) {
-                case(CON_LEFT):
-                    if (grid.tiles[i - 1].connected != CON_RIGHT) {
-                        updated = true;
-                        grid.tiles[i].connected = CON_NONE;
-                    }
-                    break;
-                case(CON_RIGHT):
-                    if (grid.tiles[i + 1].connected != CON_LEFT) {
-                        updated = true;
-                        grid.tiles[i].connected = CON_NONE;
-                    }
-                    break;
-                case(CON_UP):
-                    if (grid.tiles[i - grid.width].connected != CON_DOWN) {
-                        updated = true;
-                        grid.tiles[i].connected = CON_NONE;
-                    }
-                    break;
-                case(CON_DOWN):
-                    if (grid.tiles[i + grid.width].connected != CON_UP) {
-                        updated = true;
-                        grid.tiles[i].connected = CON_NONE;
-                    }
-                    break;
-                default:
-                    break;
-            }
-        }
+static void overlay_render() {
+    if (!overlay.visible) {
+        return;
     }
 
-    return updated;
-}
-
-static bool update_world_physics() {
-    bool updated = false;
-
-    vec2i move = {0, 1};
-    for (int i = ((grid.width * grid.height) - grid.width) - 1; i > -1; i--) {
-        if (grid.tiles[i].greyed) {
-            continue;
-        }
-        switch(grid.tiles[i].connected) {
-            case (CON_LEFT):
-                ASSERT(i % grid.width > 0, "Impossible, tile cannot be connected to the left" );
-                if (check_tile_move(grid.tiles[i - 1], move) && check_tile_move(grid.tiles[i], move)) {
-                    move_tile(&grid.tiles[i], move);
-                    updated = true;
-                }
-                break;
-            case (CON_RIGHT):
-                ASSERT(i % grid.width < grid.width - 1, "Impossible, tile cannot be connected to the right" );
-                if (check_tile_move(grid.tiles[i + 1], move) && check_tile_move(grid.tiles[i], move)) {
-                    move_tile(&grid.tiles[i], move);
-                    updated = true;
-                }
-                break;
-            default:
-                if (check_tile_move(grid.tiles[i], move)) {
-                    move_tile(&grid.tiles[i], move);
-                    updated = true;
-                }
-                break;
-        }
+    if (profile_frames() - overlay.drawn_at >= OVERLAY_REFRESH) {
+        overlay_redraw();
     }
 
-    return updated;
+    SDL_RenderCopy(state.renderer, overlay.texture, NULL, &(SDL_Rect){.x = 0, .y = 0, .w = OVERLAY_WIDTH, .h = OVERLAY_HEIGHT});
 }
+#endif
 
-void stop_player() {
-    player_set();
-    LOG("Player set");
-    player_clear();
-    LOG("Cleared player");
-
-    state.status = SCANNING;
-
-    player.active = false;
-}
+// draw the frame if anything changed, false if there was nothing to present
+static bool render() {
+    if (scene_update(&state.scene, &state.view->game, state.view_clock) == 0) {
+        return false;
+    }
 
-static bool update_player_physics() {
-    vec2i fall = {0, 1};
-    if (player_within_grid_check(fall) && player_movement_check(fall)) {
-        player_move(fall);
-        return true;
+    if (state.backend == RENDER_ATLAS) {
+        render_atlas();
     } else {
-        stop_player();
+        render_software();
     }
-    return false;
-}
-
-static void update() {
-    update_tile_connections();
 
-    // Scan for words only if not already scanned
-    if (state.status == SCANNING) {
-        if (grid_scan_for_words()) {
-            state.status = CLEARING;
-            return;
-        }
-    } else if (state.status == CLEARING){
-        // Clear the board of marked files
-        grid_clear_marked();
-        update_tile_connections();
+#ifdef PROFILE
+    overlay_render();
+#endif
 
-        state.status = HALT;
-
-        return;
+    {
+        PROFILE_SCOPE(PROFILE_PRESENT);
+        SDL_RenderPresent(state.renderer);
     }
 
-    if (state.status != PLAYING) {
-        // Drop falling tiles every tick until they can't fall anymore
-        state.status = update_world_physics() ? HALT : PLAYING;
-        if (state.status != HALT) {
-            if (grid_scan_for_words()) {
-                state.status = CLEARING;
+    scene_presented(&state.scene);
 
-                return;
-            }
+    return true;
+}
 
-            spawn_player();
-            queue_enqueue();
-        }
-    } else {
-        update_player_physics();
+static void play_sounds() {
+    if (sim_take_events(&state.sim) & GAME_EVENT_SET) {
+        Mix_PlayChannel(-1, sounds.set, 0);
     }
 }
 
+// catch the simulation up unless it has a thread of its own
 static void tick() {
-    // varying tick speeds --> larger = slower
-    switch (state.status) {
-        case (HALT):
-            state.tick = 250;
-            break;
-        case (CLEARING):
-            state.tick = 250;
-            break;
-        case (SCANNING):
-            state.tick = 100;
-            break;
-        case (PLAYING):
-            state.tick = 1500;
-            break;
-        default:
-            state.tick = 10;
-    }
-
-    if (SDL_GetTicks() >= state.time + state.tick) {
-        state.time = SDL_GetTicks();
-
-        update();
+    if (!state.sim_thread) {
+        sim_advance(&state.sim, SDL_GetTicks64());
     }
 }
 
-static bool player_check_movement(vec2i move) {
-    if (player_within_grid_check(move) && player_movement_check(move))
-        return true;
-    return false;
-}
-
-void tile_set_marked(tile_t *t, bool marked) {
-    t->marked = marked;
-}
-
-static void player_rotate_cw() {
-    vec2i t1pos = player.t1.pos;
-    vec2i t2pos = player.t2.pos;
-
-    short t1con = player.t1.connected;
-    short t2con = player.t2.connected;
-
-    if (t1pos.x < t2pos.x) {
-        LOG("cw rotation 1");
-        t1pos.y -= 1;
-        t2pos.x -= 1;
-        t1con = CON_DOWN;
-        t2con = CON_UP;
-    } else if (t1pos.x == t2pos.x && t1pos.y < t2pos.y) {
-        LOG("cw rotation 2");
-        t1pos.y += 1;
-        t1pos.x += 1;
-        t1con = CON_LEFT;
-        t2con = CON_RIGHT;
-    } else if (t1pos.x > t2pos.x && t1pos.y == t2pos.y) {
-        LOG("cw rotation 3");
-        t1pos.x -= 1;
-        t2pos.y -= 1;
-        t1con = CON_UP;
-        t2con = CON_DOWN;
-    } else {
-        LOG("cw rotation 4");
-        t2pos.x += 1;
-        t2pos.y += 1;
-        t1con = CON_RIGHT;
-        t2con = CON_LEFT;
-    }
-
-    if (t1pos.y < 0 || t2pos.y < 0) {
-        return;
-    }
-
-    bool kick_check =
-        (grid.tiles[at(t2pos.y, t2pos.x, grid.width)].filled &&
-        !grid.tiles[at(t2pos.y, t2pos.x - 1, grid.width)].filled) || (t1pos.x >= grid.width) || (t2pos.x >= grid.width) ||
-        (grid.tiles[at(t1pos.y, t1pos.x, grid.width)].filled &&
-        !grid.tiles[at(t1pos.y, t1pos.x - 1, grid.width)].filled);
-
-    if (kick_check) {
-        LOG("kick left");
-        t1pos.x -= 1;
-        t2pos.x -= 1;
-    }
-
-    bool t1_check = (grid.tiles[at(t1pos.y, t1pos.x, grid.width)].filled || t1pos.x < 0 || t1pos.x >= grid.width);
-    bool t2_check = (grid.tiles[at(t2pos.y, t2pos.x, grid.width)].filled || t2pos.x < 0 || t2pos.x >= grid.width);
-
-    if (t1_check || t2_check) {
-        return;
+// queue a command for the simulation at the time its event happened
+static void push_command(enum sim_command command, u32 timestamp) {
+    if (sim_push(&state.sim, command, timestamp)) {
+        latency.pressed[latency.pushed++ % LATENCY_PENDING] = timestamp;
     }
-
-    player.t1.pos = t1pos;
-    player.t2.pos = t2pos;
-
-    player.t1.connected = t1con;
-    player.t2.connected = t2con;
 }
 
-static void player_rotate_ccw() {
-    vec2i t1pos = player.t1.pos;
-    vec2i t2pos = player.t2.pos;
-
-    short t1con = player.t1.connected;
-    short t2con = player.t2.connected;
-
-    if (t1pos.x < t2pos.x) {
-        LOG("ccw rotation 1");
-        t1pos.x += 1;
-        t2pos.y -= 1;
-        t1con = CON_UP;
-        t2con = CON_DOWN;
-    } else if (t1pos.x == t2pos.x && t1pos.y > t2pos.y) {
-        LOG("ccw rotation 2");
-        t2pos.x -= 1;
-        t2pos.y += 1;
-        t1con = CON_LEFT;
-        t2con = CON_RIGHT;
-    } else if (t1pos.x > t2pos.x && t1pos.y == t2pos.y) {
-        LOG("ccw rotation 3");
-        t2pos.x += 1;
-        t1pos.y -= 1;
-        t1con = CON_DOWN;
-        t2con = CON_UP;
-    } else {
-        LOG("ccw rotation 4");
-        t1pos.y += 1;
-        t1pos.x -= 1;
-        t1con = CON_RIGHT;
-        t2con = CON_LEFT;
-    }
-
-    if (t1pos.y < 0 || t2pos.y < 0) {
-        return;
-    }
-
-    bool kick_check =
-        (grid.tiles[at(t2pos.y, t2pos.x, grid.width)].filled &&
-        !grid.tiles[at(t2pos.y, t2pos.x + 1, grid.width)].filled) || (t1pos.x < 0) || (t2pos.x < 0) ||
-        (grid.tiles[at(t1pos.y, t1pos.x, grid.width)].filled &&
-        !grid.tiles[at(t1pos.y, t1pos.x + 1, grid.width)].filled);
+// sample the latency of every command the frame just drawn includes, or drop
+// the samples if nothing was presented because they changed nothing on screen
+static void record_latency(bool presented) {
+    double now = SDL_GetTicks64();
+    u32 shown = state.view->inputs;
 
-    if (kick_check) {
-        LOG("kick right");
-        t1pos.x += 1;
-        t2pos.x += 1;
+    if (latency.pushed - latency.shown > LATENCY_PENDING) {
+        latency.shown = latency.pushed - LATENCY_PENDING;
     }
 
-    bool t1_move_failed =
-        (grid.tiles[at(t1pos.y, t1pos.x, grid.width)].filled ||
-        t1pos.x < 0 || t1pos.x >= grid.width);
-    bool t2_move_failed =
-        (grid.tiles[at(t2pos.y, t2pos.x, grid.width)].filled ||
-        t2pos.x < 0 || t2pos.x >= grid.width);
-
-    if (t1_move_failed || t2_move_failed) {
-        return;
+    for (; latency.shown != shown; latency.shown++) {
+        if (presented) {
+            samples_add(&latency.samples, now - latency.pressed[latency.shown % LATENCY_PENDING]);
+        }
     }
-
-    player.t1.pos = t1pos;
-    player.t2.pos = t2pos;
-
-    player.t1.connected = t1con;
-    player.t2.connected = t2con;
 }
 
+static void report_latency() {
+    struct samples *s = &latency.samples;
+    LOG("Input latency over %u presses: p50 %.0f ms, p90 %.0f ms, p99 %.0f ms, max %.0f ms", s->count,
+        samples_percentile(s, 50), samples_percentile(s, 90), samples_percentile(s, 99), samples_percentile(s, 100));
+}
 
-static void grid_init(int cols, int rows) {
-    int grid_x = (SCREEN_WIDTH / 2) - ((10 * TILE_SIZE) / 2);
-    int grid_y = TILE_SIZE / 2;
-
-    grid.width = cols;
-    grid.height = rows;
-    grid.tiles = malloc(rows * cols * sizeof(tile_t));
-    // Check if memory allocation was successful (not NULL)
-    ASSERT(grid.tiles != NULL, "Memory allocation failed for tiles.");
+// pick up the newest game state and the time to draw it at
+static void sync_view() {
+    state.view = sim_snapshot(&state.sim);
+    state.view_clock = sim_snapshot_clock(state.view, SDL_GetTicks64());
+}
 
-    for (uint i = 0; i < grid.width * grid.height; i++) {
-        grid.tiles[i] = *tile_create_empty();
+// --sim-thread: step the game here, independent of how long frames take
+static int sim_thread(void *data) {
+    while (sim_advance(&state.sim, SDL_GetTicks64())) {
+        // round up, waking early would only spin
+        SDL_Delay((u32)sim_until_step(&state.sim) + 1);
     }
-    grid.obj = (obj_info_t){
-        .pos = {grid_x, grid_y},
-        .sprite = &((sprite){}),
-        .size = {cols * TILE_SIZE, rows * TILE_SIZE},
-    };
-}
 
-static void grid_destroy(struct grid* grid) {
-    free(grid->tiles);
+    return 0;
 }
 
-static void queue_init() {
-    LOG("Creating queue...");
-    int x = (SCREEN_WIDTH - (3.25 * TILE_SIZE));
-    int y = TILE_SIZE / 2;
-    int w = TILE_SIZE * 3;
-    int h = TILE_SIZE * 2;
-
-    queue.obj = (obj_info_t){
-        .size = {w, h},
-        .pos = {x, y},
-        .sprite = &sprites[26],
-    };
-    LOG("Queue created");
+// nothing changed on screen, sleep until input arrives or the next tick is due
+static void idle() {
+    const struct game *g = &state.view->game;
+    double next_tick = g->time + game_tick_length(g);
+    int timeout = next_tick - state.view_clock;
+    if (timeout < 1) timeout = 1;
+
+    SDL_WaitEventTimeout(NULL, timeout);
 }
 
 static void handle_input() {
@@ -872,12 +347,15 @@ static void handle_input() {
     while (SDL_PollEvent(&ev)) {
         switch (ev.type) {
             case SDL_QUIT:
-                // state.quit = true;
-                state.status = QUIT;
+                push_command(SIM_QUIT, ev.common.timestamp);
+                break;
+            case SDL_WINDOWEVENT:
+                // exposed, resized or restored, the old picture can't be trusted
+                state.scene.full = true;
                 break;
             case SDL_MOUSEBUTTONDOWN: {
                 int tile_index = pix_pos_to_grid_index(state.mouse_pos);
-                tile_t t = grid.tiles[tile_index];
+                tile_t t = state.scene.tiles[tile_index];
                 LOG("\nTILE %d:\n.connected='%d',\n.letter='%c',\n.pos=(%d, %d),\n.filled=%d,\n.marked=%d",
                     tile_index, t.connected, t.letter, t.pos.x, t.pos.y, t.filled, t.marked);
                 break;
@@ -889,47 +367,35 @@ static void handle_input() {
                 /* Check the SDLKey values and move change the coords */
                 switch ( ev.key.keysym.sym ) {
                     case SDLK_ESCAPE: {
-                        // state.quit = true;
-                        state.status = QUIT;
+                        push_command(SIM_QUIT, ev.key.timestamp);
                     }
                     case SDLK_a:
-                    case SDLK_LEFT: {
-                        vec2i move = (vec2i){-1, 0};
-                        if (player_check_movement(move))
-                            player_move(move);
+                    case SDLK_LEFT:
+                        push_command(SIM_SHIFT_LEFT, ev.key.timestamp);
                         break;
-                    }
                     case SDLK_d:
-                    case SDLK_RIGHT: {
-                        vec2i move = (vec2i){1, 0};
-                        if (player_check_movement(move))
-                            player_move(move);
+                    case SDLK_RIGHT:
+                        push_command(SIM_SHIFT_RIGHT, ev.key.timestamp);
                         break;
-                    }
                     case SDLK_s:
-                    case SDLK_DOWN: {
-                        if (state.status == PLAYING) {
-                            vec2i move = (vec2i){0, 1};
-                            if (player_check_movement(move)) {
-                                state.time = SDL_GetTicks();
-                                player_move(move);
-                            }
-                            else {
-                                stop_player();
-                            }
-                        }
+                    case SDLK_DOWN:
+                        push_command(SIM_DROP, ev.key.timestamp);
                         break;
-                    }
                     case SDLK_k:
-                        player_rotate_cw();
+                        push_command(SIM_ROTATE_CW, ev.key.timestamp);
                         break;
                     case SDLK_j:
-                        player_rotate_ccw();
+                        push_command(SIM_ROTATE_CCW, ev.key.timestamp);
                         break;
                     case SDLK_w:
                     case SDLK_UP:
-                        player_flip();
+                        push_command(SIM_FLIP, ev.key.timestamp);
                         break;
+#ifdef PROFILE
+                    case SDLK_F3:
+                        overlay_toggle();
+                        break;
+#endif
                     default:
                         break;
                 }
@@ -938,6 +404,20 @@ static void handle_input() {
     }
 }
 
+// one pass of the main loop short of sleeping, true if a frame was presented
+static bool run_frame() {
+    PROFILE_SCOPE(PROFILE_FRAME);
+
+    handle_input();
+
+    tick();
+    sync_view();
+
+    play_sounds();
+
+    return render();
+}
+
 static void sdl_init() {
     ASSERT(!SDL_Init(SDL_INIT_VIDEO), "SDL failed to initialize: %s\n", SDL_GetError());
 
@@ -958,42 +438,94 @@ static void sdl_init() {
     Mix_AllocateChannels(8);
 }
 
-static void game_init() {
-    srand(time(NULL));
+static void game_start(enum game_gravity gravity, u64 seed, bool threaded) {
     load_sprites();
+    scene_init(&state.scene, &assets, 10, 10);
 
-    state.status = PLAYING;
-    state.dict_trie = trie_node_create();
-    trie_construct(state.dict_trie, "./dictionary.txt");
+    if (state.backend == RENDER_ATLAS && !load_atlas()) {
+        LOG("Couldn't create the sprite atlas, using the software renderer: %s", SDL_GetError());
+        state.backend = RENDER_SOFTWARE;
+    }
 
-    lpool_init(&state.letter_pool);
-    lpool_populate(&state.letter_pool);
+    state.dict_trie = trie_create();
+    trie_load(state.dict_trie, "./dictionary.bin", "./dictionary.txt");
 
-    grid_init(10, 10);
-    grid_randomize_grey_tiles();
+    // log the seed so a game can be replayed with --seed
+    LOG("Seed %llu", (unsigned long long)seed);
+    game_init(&state.game, state.dict_trie, state.scene.cols, state.scene.rows, seed);
+    state.game.gravity = gravity;
+    line_cache_init(&state.lines);
+    state.game.lines = &state.lines;
 
-    queue_init();
-    queue_enqueue();
-    spawn_player();
-    queue_enqueue();
+    sim_init(&state.sim, &state.game, SDL_GetTicks64());
+    if (threaded) {
+        state.sim_thread = SDL_CreateThread(sim_thread, "sim", NULL);
+        ASSERT(state.sim_thread, "Failed to start the simulation thread: %s\n", SDL_GetError());
+    }
+    sync_view();
 }
 
 int main(int argc, char *argv[]) {
+    enum game_gravity gravity = GRAVITY_STEP;
+    u64 seed = time(NULL);
+    bool threaded = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--settle") == 0) {
+            gravity = GRAVITY_SETTLE;
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--atlas") == 0) {
+            state.backend = RENDER_ATLAS;
+        } else if (strcmp(argv[i], "--sim-thread") == 0) {
+            threaded = true;
+        } else if (strcmp(argv[i], "--latency") == 0) {
+            latency.enabled = true;
+            samples_reserve(&latency.samples, LATENCY_RESERVE);
+#ifdef PROFILE
+        } else if (strcmp(argv[i], "--profile-csv") == 0 && i + 1 < argc) {
+            const char *file = argv[++i];
+            if (profile_open_csv(file) != 0) {
+                LOG("Couldn't create %s, frame timings won't be written", file);
+            }
+#endif
+        }
+    }
+
     sdl_init();
-    game_init();
+    game_start(gravity, seed, threaded);
 
     sounds.set = Mix_LoadWAV("sfx/set.wav");
 
-    while (state.status != QUIT) {
-        tick();
+    while (state.view->game.status != QUIT) {
+        bool presented = run_frame();
+        if (latency.enabled) {
+            record_latency(presented);
+        }
+
+        // frames that present nothing add their time to the next one
+        if (presented) {
+            PROFILE_FRAME_END();
+        } else {
+            idle();
+        }
+    }
+
+    if (latency.enabled) {
+        report_latency();
+        samples_destroy(&latency.samples);
+    }
 
-        handle_input();
+    profile_close_csv();
 
-        render();
+    if (state.sim_thread) {
+        SDL_WaitThread(state.sim_thread, NULL);
     }
 
-    grid_destroy(&grid);
-    lpool_destroy(&state.letter_pool);
+    scene_destroy(&state.scene);
+    game_destroy(&state.game);
+    line_cache_destroy(&state.lines);
+    atlas_destroy(&state.atlas);
+    assets_destroy(&assets);
     trie_destroy(state.dict_trie);
 
     SDL_DestroyTexture(state.texture);
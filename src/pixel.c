@@ -0,0 +1,344 @@
+#include "../include/pixel.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PIXEL_X86
+#endif
+
+// lighten moves each channel this far towards 255, in 1/65536ths. These are
+// the smallest weights that reproduce the old 0.3/0.4/0.7 float multiplies
+// exactly for every channel value.
+#define LIGHTEN_R 19661
+#define LIGHTEN_G 26215
+#define LIGHTEN_B 45876
+
+// (sum * DIV3) >> 16 == sum / 3 for every sum of three channels
+#define DIV3 21846
+
+/*
+
+ SCALAR
+
+*/
+static void fill_scalar(u32 *dst, u32 color, usize count) {
+    for (usize i = 0; i < count; i++) {
+        dst[i] = color;
+    }
+}
+
+static void greyscale_scalar(u32 *dst, const u32 *src, usize count) {
+    for (usize i = 0; i < count; i++) {
+        u32 pix = src[i];
+        u32 sum = ((pix >> 16) & 0xFF) + ((pix >> 8) & 0xFF) + (pix & 0xFF);
+        u32 avg = (sum * DIV3) >> 16;
+        dst[i] = (pix & 0xFF000000) | (avg << 16) | (avg << 8) | avg;
+    }
+}
+
+static void lighten_scalar(u32 *dst, const u32 *src, usize count) {
+    for (usize i = 0; i < count; i++) {
+        u32 pix = src[i];
+        u32 r = pix & 0xFF;
+        u32 g = (pix >> 8) & 0xFF;
+        u32 b = (pix >> 16) & 0xFF;
+        r += ((255 - r) * LIGHTEN_R) >> 16;
+        g += ((255 - g) * LIGHTEN_G) >> 16;
+        b += ((255 - b) * LIGHTEN_B) >> 16;
+        dst[i] = (pix & 0xFF000000) | (b << 16) | (g << 8) | r;
+    }
+}
+
+static void darken_scalar(u32 *dst, const u32 *src, usize count) {
+    for (usize i = 0; i < count; i++) {
+        dst[i] = (src[i] & 0x00fefefe) >> 1;
+    }
+}
+
+static void halve_rows_scalar(u32 *dst, const u32 *row0, const u32 *row1, usize count) {
+    for (usize i = 0; i < count; i++) {
+        u32 q[4] = {row0[2 * i], row0[2 * i + 1], row1[2 * i], row1[2 * i + 1]};
+        u32 out = 0;
+        for (int shift = 0; shift < 32; shift += 8) {
+            u32 sum = ((q[0] >> shift) & 0xFF) + ((q[1] >> shift) & 0xFF) +
+                      ((q[2] >> shift) & 0xFF) + ((q[3] >> shift) & 0xFF);
+            out |= (sum / 4) << shift;
+        }
+        dst[i] = out;
+    }
+}
+
+#ifdef PIXEL_X86
+/*
+
+ SSE2, 4 pixels at a time
+
+*/
+__attribute__((target("sse2")))
+static void fill_sse2(u32 *dst, u32 color, usize count) {
+    __m128i c = _mm_set1_epi32(color);
+    usize i = 0;
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_si128((__m128i *)&dst[i], c);
+    }
+    fill_scalar(dst + i, color, count - i);
+}
+
+__attribute__((target("sse2")))
+static void greyscale_sse2(u32 *dst, const u32 *src, usize count) {
+    const __m128i byte = _mm_set1_epi32(0xFF);
+    const __m128i alpha = _mm_set1_epi32(0xFF000000);
+    const __m128i div3 = _mm_set1_epi32(DIV3);
+    usize i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i *)&src[i]);
+        __m128i sum = _mm_add_epi32(_mm_and_si128(v, byte),
+                      _mm_add_epi32(_mm_and_si128(_mm_srli_epi32(v, 8), byte),
+                                    _mm_and_si128(_mm_srli_epi32(v, 16), byte)));
+        // sum sits in the low 16 bits of each lane, the high halves stay 0
+        __m128i avg = _mm_mulhi_epu16(sum, div3);
+        __m128i grey = _mm_or_si128(avg, _mm_or_si128(_mm_slli_epi32(avg, 8), _mm_slli_epi32(avg, 16)));
+        _mm_storeu_si128((__m128i *)&dst[i], _mm_or_si128(grey, _mm_and_si128(v, alpha)));
+    }
+    greyscale_scalar(dst + i, src + i, count - i);
+}
+
+__attribute__((target("sse2")))
+static void lighten_sse2(u32 *dst, const u32 *src, usize count) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i max = _mm_set1_epi16(255);
+    // per 16 bit channel lane: r, g, b, a (alpha is left alone)
+    const __m128i weights = _mm_setr_epi16(LIGHTEN_R, LIGHTEN_G, LIGHTEN_B, 0, LIGHTEN_R, LIGHTEN_G, LIGHTEN_B, 0);
+    usize i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i *)&src[i]);
+        __m128i lo = _mm_unpacklo_epi8(v, zero);
+        __m128i hi = _mm_unpackhi_epi8(v, zero);
+        lo = _mm_add_epi16(lo, _mm_mulhi_epu16(_mm_sub_epi16(max, lo), weights));
+        hi = _mm_add_epi16(hi, _mm_mulhi_epu16(_mm_sub_epi16(max, hi), weights));
+        _mm_storeu_si128((__m128i *)&dst[i], _mm_packus_epi16(lo, hi));
+    }
+    lighten_scalar(dst + i, src + i, count - i);
+}
+
+__attribute__((target("sse2")))
+static void darken_sse2(u32 *dst, const u32 *src, usize count) {
+    const __m128i mask = _mm_set1_epi32(0x00fefefe);
+    usize i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i *)&src[i]);
+        _mm_storeu_si128((__m128i *)&dst[i], _mm_srli_epi32(_mm_and_si128(v, mask), 1));
+    }
+    darken_scalar(dst + i, src + i, count - i);
+}
+
+// split 8 pixels into the even ones and the odd ones
+__attribute__((target("sse2")))
+static inline void deinterleave_sse2(const u32 *p, __m128i *even, __m128i *odd) {
+    __m128i a = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)p), _MM_SHUFFLE(3, 1, 2, 0));
+    __m128i b = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)(p + 4)), _MM_SHUFFLE(3, 1, 2, 0));
+    *even = _mm_unpacklo_epi64(a, b);
+    *odd = _mm_unpackhi_epi64(a, b);
+}
+
+__attribute__((target("sse2")))
+static void halve_rows_sse2(u32 *dst, const u32 *row0, const u32 *row1, usize count) {
+    const __m128i zero = _mm_setzero_si128();
+    usize i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i e0, o0, e1, o1;
+        deinterleave_sse2(row0 + 2 * i, &e0, &o0);
+        deinterleave_sse2(row1 + 2 * i, &e1, &o1);
+
+        __m128i lo = _mm_add_epi16(_mm_add_epi16(_mm_unpacklo_epi8(e0, zero), _mm_unpacklo_epi8(o0, zero)),
+                                   _mm_add_epi16(_mm_unpacklo_epi8(e1, zero), _mm_unpacklo_epi8(o1, zero)));
+        __m128i hi = _mm_add_epi16(_mm_add_epi16(_mm_unpackhi_epi8(e0, zero), _mm_unpackhi_epi8(o0, zero)),
+                                   _mm_add_epi16(_mm_unpackhi_epi8(e1, zero), _mm_unpackhi_epi8(o1, zero)));
+        _mm_storeu_si128((__m128i *)&dst[i], _mm_packus_epi16(_mm_srli_epi16(lo, 2), _mm_srli_epi16(hi, 2)));
+    }
+    halve_rows_scalar(dst + i, row0 + 2 * i, row1 + 2 * i, count - i);
+}
+
+/*
+
+ AVX2, 8 pixels at a time. Unpacks and packs work within 128 bit halves,
+ so pixel order survives them unchanged.
+
+*/
+__attribute__((target("avx2")))
+static void fill_avx2(u32 *dst, u32 color, usize count) {
+    __m256i c = _mm256_set1_epi32(color);
+    usize i = 0;
+    for (; i + 8 <= count; i += 8) {
+        _mm256_storeu_si256((__m256i *)&dst[i], c);
+    }
+    fill_scalar(dst + i, color, count - i);
+}
+
+__attribute__((target("avx2")))
+static void greyscale_avx2(u32 *dst, const u32 *src, usize count) {
+    const __m256i byte = _mm256_set1_epi32(0xFF);
+    const __m256i alpha = _mm256_set1_epi32(0xFF000000);
+    const __m256i div3 = _mm256_set1_epi32(DIV3);
+    usize i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)&src[i]);
+        __m256i sum = _mm256_add_epi32(_mm256_and_si256(v, byte),
+                      _mm256_add_epi32(_mm256_and_si256(_mm256_srli_epi32(v, 8), byte),
+                                       _mm256_and_si256(_mm256_srli_epi32(v, 16), byte)));
+        __m256i avg = _mm256_mulhi_epu16(sum, div3);
+        __m256i grey = _mm256_or_si256(avg, _mm256_or_si256(_mm256_slli_epi32(avg, 8), _mm256_slli_epi32(avg, 16)));
+        _mm256_storeu_si256((__m256i *)&dst[i], _mm256_or_si256(grey, _mm256_and_si256(v, alpha)));
+    }
+    greyscale_scalar(dst + i, src + i, count - i);
+}
+
+__attribute__((target("avx2")))
+static void lighten_avx2(u32 *dst, const u32 *src, usize count) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i max = _mm256_set1_epi16(255);
+    const __m256i weights = _mm256_setr_epi16(LIGHTEN_R, LIGHTEN_G, LIGHTEN_B, 0, LIGHTEN_R, LIGHTEN_G, LIGHTEN_B, 0,
+                                              LIGHTEN_R, LIGHTEN_G, LIGHTEN_B, 0, LIGHTEN_R, LIGHTEN_G, LIGHTEN_B, 0);
+    usize i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)&src[i]);
+        __m256i lo = _mm256_unpacklo_epi8(v, zero);
+        __m256i hi = _mm256_unpackhi_epi8(v, zero);
+        lo = _mm256_add_epi16(lo, _mm256_mulhi_epu16(_mm256_sub_epi16(max, lo), weights));
+        hi = _mm256_add_epi16(hi, _mm256_mulhi_epu16(_mm256_sub_epi16(max, hi), weights));
+        _mm256_storeu_si256((__m256i *)&dst[i], _mm256_packus_epi16(lo, hi));
+    }
+    lighten_scalar(dst + i, src + i, count - i);
+}
+
+__attribute__((target("avx2")))
+static void darken_avx2(u32 *dst, const u32 *src, usize count) {
+    const __m256i mask = _mm256_set1_epi32(0x00fefefe);
+    usize i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)&src[i]);
+        _mm256_storeu_si256((__m256i *)&dst[i], _mm256_srli_epi32(_mm256_and_si256(v, mask), 1));
+    }
+    darken_scalar(dst + i, src + i, count - i);
+}
+
+__attribute__((target("avx2")))
+static void halve_rows_avx2(u32 *dst, const u32 *row0, const u32 *row1, usize count) {
+    const __m256i zero = _mm256_setzero_si256();
+    // gathers pixels 0, 2, 4, 6 into the low half and 1, 3, 5, 7 into the high half
+    const __m256i split = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+    usize i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i a0 = _mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i *)(row0 + 2 * i)), split);
+        __m256i b0 = _mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i *)(row0 + 2 * i + 8)), split);
+        __m256i a1 = _mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i *)(row1 + 2 * i)), split);
+        __m256i b1 = _mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i *)(row1 + 2 * i + 8)), split);
+
+        __m256i e0 = _mm256_permute2x128_si256(a0, b0, 0x20), o0 = _mm256_permute2x128_si256(a0, b0, 0x31);
+        __m256i e1 = _mm256_permute2x128_si256(a1, b1, 0x20), o1 = _mm256_permute2x128_si256(a1, b1, 0x31);
+
+        __m256i lo = _mm256_add_epi16(_mm256_add_epi16(_mm256_unpacklo_epi8(e0, zero), _mm256_unpacklo_epi8(o0, zero)),
+                                      _mm256_add_epi16(_mm256_unpacklo_epi8(e1, zero), _mm256_unpacklo_epi8(o1, zero)));
+        __m256i hi = _mm256_add_epi16(_mm256_add_epi16(_mm256_unpackhi_epi8(e0, zero), _mm256_unpackhi_epi8(o0, zero)),
+                                      _mm256_add_epi16(_mm256_unpackhi_epi8(e1, zero), _mm256_unpackhi_epi8(o1, zero)));
+        _mm256_storeu_si256((__m256i *)&dst[i], _mm256_packus_epi16(_mm256_srli_epi16(lo, 2), _mm256_srli_epi16(hi, 2)));
+    }
+    halve_rows_sse2(dst + i, row0 + 2 * i, row1 + 2 * i, count - i);
+}
+#endif
+
+/*
+
+ DISPATCH
+
+*/
+static struct {
+    bool selected;
+    enum pixel_isa isa;
+    void (*fill)(u32 *, u32, usize);
+    void (*greyscale)(u32 *, const u32 *, usize);
+    void (*lighten)(u32 *, const u32 *, usize);
+    void (*darken)(u32 *, const u32 *, usize);
+    void (*halve_rows)(u32 *, const u32 *, const u32 *, usize);
+} kernels;
+
+enum pixel_isa pixels_best_isa() {
+#ifdef PIXEL_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return PIXEL_AVX2;
+    if (__builtin_cpu_supports("sse2")) return PIXEL_SSE2;
+#endif
+    return PIXEL_SCALAR;
+}
+
+const char *pixels_isa_name(enum pixel_isa isa) {
+    switch (isa) {
+        case PIXEL_AVX2:
+            return "avx2";
+        case PIXEL_SSE2:
+            return "sse2";
+        default:
+            return "scalar";
+    }
+}
+
+enum pixel_isa pixels_use(enum pixel_isa isa) {
+    enum pixel_isa best = pixels_best_isa();
+    if (isa > best) isa = best;
+
+    kernels.isa = isa;
+    kernels.fill = fill_scalar;
+    kernels.greyscale = greyscale_scalar;
+    kernels.lighten = lighten_scalar;
+    kernels.darken = darken_scalar;
+    kernels.halve_rows = halve_rows_scalar;
+
+#ifdef PIXEL_X86
+    if (isa == PIXEL_SSE2) {
+        kernels.fill = fill_sse2;
+        kernels.greyscale = greyscale_sse2;
+        kernels.lighten = lighten_sse2;
+        kernels.darken = darken_sse2;
+        kernels.halve_rows = halve_rows_sse2;
+    } else if (isa == PIXEL_AVX2) {
+        kernels.fill = fill_avx2;
+        kernels.greyscale = greyscale_avx2;
+        kernels.lighten = lighten_avx2;
+        kernels.darken = darken_avx2;
+        kernels.halve_rows = halve_rows_avx2;
+    }
+#endif
+
+    kernels.selected = true;
+    return isa;
+}
+
+static inline void pixels_select() {
+    if (!kernels.selected) {
+        pixels_use(PIXEL_AVX2);
+    }
+}
+
+void pixels_fill(u32 *dst, u32 color, usize count) {
+    pixels_select();
+    kernels.fill(dst, color, count);
+}
+
+void pixels_greyscale(u32 *dst, const u32 *src, usize count) {
+    pixels_select();
+    kernels.greyscale(dst, src, count);
+}
+
+void pixels_lighten(u32 *dst, const u32 *src, usize count) {
+    pixels_select();
+    kernels.lighten(dst, src, count);
+}
+
+void pixels_darken(u32 *dst, const u32 *src, usize count) {
+    pixels_select();
+    kernels.darken(dst, src, count);
+}
+
+void pixels_halve_rows(u32 *dst, const u32 *row0, const u32 *row1, usize count) {
+    pixels_select();
+    kernels.halve_rows(dst, row0, row1, count);
+}
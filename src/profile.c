@@ -0,0 +1,134 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <time.h>
+
+#include "../include/profile.h"
+#include "../include/stats.h"
+#include "../include/macros.h"
+
+const char *profile_phase_names[PROFILE_PHASE_COUNT] = {
+    [PROFILE_FRAME] = "frame",
+    [PROFILE_DRAW_BG] = "bg",
+    [PROFILE_DRAW_GRID] = "grid",
+    [PROFILE_DRAW_RESTORE] = "restore",
+    [PROFILE_DRAW_TILES] = "tiles",
+    [PROFILE_UPLOAD] = "upload",
+    [PROFILE_PRESENT] = "present",
+    [PROFILE_UPDATE] = "update",
+    [PROFILE_SCAN] = "scan",
+    [PROFILE_PHYSICS] = "physics",
+};
+
+const char *profile_counter_names[PROFILE_COUNTER_COUNT] = {
+    [PROFILE_LINE_CACHE_HITS] = "line_hits",
+    [PROFILE_LINE_CACHE_MISSES] = "line_misses",
+};
+
+_Thread_local struct profile_timer *profile_open_timer;
+
+static struct {
+    // ns spent in each phase this frame, added to from any thread
+    _Atomic u64 current[PROFILE_PHASE_COUNT];
+    _Atomic u64 counts[PROFILE_COUNTER_COUNT];
+
+    // ring of the last PROFILE_WINDOW frames, ns and counts
+    u64 history[PROFILE_PHASE_COUNT][PROFILE_WINDOW];
+    u64 count_history[PROFILE_COUNTER_COUNT][PROFILE_WINDOW];
+    u32 frames;
+
+    FILE *csv;
+} profile;
+
+u64 profile_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+void profile_add(enum profile_phase phase, u64 ns) {
+    atomic_fetch_add_explicit(&profile.current[phase], ns, memory_order_relaxed);
+}
+
+void profile_count(enum profile_counter counter, u64 n) {
+    atomic_fetch_add_explicit(&profile.counts[counter], n, memory_order_relaxed);
+}
+
+void profile_frame_end(void) {
+    u32 slot = profile.frames % PROFILE_WINDOW;
+
+    for (int i = 0; i < PROFILE_PHASE_COUNT; i++) {
+        profile.history[i][slot] = atomic_exchange_explicit(&profile.current[i], 0, memory_order_relaxed);
+    }
+    for (int i = 0; i < PROFILE_COUNTER_COUNT; i++) {
+        profile.count_history[i][slot] = atomic_exchange_explicit(&profile.counts[i], 0, memory_order_relaxed);
+    }
+
+    if (profile.csv) {
+        fprintf(profile.csv, "%u", profile.frames);
+        for (int i = 0; i < PROFILE_PHASE_COUNT; i++) {
+            fprintf(profile.csv, ",%.4f", profile.history[i][slot] / 1e6);
+        }
+        for (int i = 0; i < PROFILE_COUNTER_COUNT; i++) {
+            fprintf(profile.csv, ",%llu", (unsigned long long)profile.count_history[i][slot]);
+        }
+        fputc('\n', profile.csv);
+    }
+
+    profile.frames++;
+}
+
+u32 profile_frames(void) {
+    return profile.frames;
+}
+
+double profile_percentile(enum profile_phase phase, double p) {
+    double values[PROFILE_WINDOW];
+    u32 count = profile.frames < PROFILE_WINDOW ? profile.frames : PROFILE_WINDOW;
+
+    for (u32 i = 0; i < count; i++) {
+        values[i] = profile.history[phase][i] / 1e6;
+    }
+
+    // borrow the window for the sort, nothing is allocated
+    struct samples s = {.values = values, .count = count, .capacity = PROFILE_WINDOW, .sorted = false};
+    return samples_percentile(&s, p);
+}
+
+u64 profile_counter_sum(enum profile_counter counter) {
+    u32 count = profile.frames < PROFILE_WINDOW ? profile.frames : PROFILE_WINDOW;
+    u64 sum = 0;
+
+    for (u32 i = 0; i < count; i++) {
+        sum += profile.count_history[counter][i];
+    }
+
+    return sum;
+}
+
+int profile_open_csv(const char *file) {
+    profile_close_csv();
+
+    profile.csv = fopen(file, "w");
+    if (profile.csv == NULL) {
+        return -1;
+    }
+
+    fprintf(profile.csv, "index");
+    for (int i = 0; i < PROFILE_PHASE_COUNT; i++) {
+        fprintf(profile.csv, ",%s_ms", profile_phase_names[i]);
+    }
+    for (int i = 0; i < PROFILE_COUNTER_COUNT; i++) {
+        fprintf(profile.csv, ",%s", profile_counter_names[i]);
+    }
+    fputc('\n', profile.csv);
+
+    return 0;
+}
+
+void profile_close_csv(void) {
+    if (profile.csv) {
+        fclose(profile.csv);
+        profile.csv = NULL;
+    }
+}
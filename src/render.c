@@ -1,5 +1,11 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include "../include/render.h"
 #include "../include/macros.h"
+#include "../include/alloc.h"
+#include "../include/pixel.h"
 
 void obj_render(obj_info_t *obj, SDL_Texture *tex) {
     SDL_UpdateTexture(tex,
@@ -23,57 +29,192 @@ void pix_buf_render(int x, int y, int w, int h, u32 *pixels, SDL_Texture *tex) {
                       w * 4);
 }
 
-void verline(int x, int y0, int y1, u32 color, u32* pixels, int pix_buf_width) {
-    for (int y = y0; y <= y1; y++)
-        pixels[(y * pix_buf_width) + x] = color;
+void pix_buf_render_stride(int x, int y, int w, int h, u32 *pixels, int stride, SDL_Texture *tex) {
+    SDL_UpdateTexture(tex,
+                      &(SDL_Rect){.x=x, .y=y, .w=w, .h=h},
+                      pixels,
+                      stride * 4);
 }
 
 u32* line(int length, u32 color) {
-    u32 *pixels = malloc(sizeof(u32) * length);
-
-    for (int i = 0; i < length; i++) {
-        pixels[i] = color;
-    }
+    u32 *pixels = ALLOC(sizeof(u32) * length);
+    pixels_fill(pixels, color, length);
 
     return pixels;
 }
 
-void horiline(int x0, int x1, int y, u32 color, u32* pixels, int pix_buf_width) {
-    for (int x = x0; x <= x1; x++)
-        pixels[(y * pix_buf_width) + x] = color;
+// 3x5 glyphs, one bit per pixel, rows top to bottom from bit 14
+#define GLYPH(_r0, _r1, _r2, _r3, _r4) (((_r0) << 12) | ((_r1) << 9) | ((_r2) << 6) | ((_r3) << 3) | (_r4))
+
+static const u16 glyphs[128] = {
+    ['0'] = GLYPH(07, 05, 05, 05, 07), ['1'] = GLYPH(02, 06, 02, 02, 07),
+    ['2'] = GLYPH(07, 01, 07, 04, 07), ['3'] = GLYPH(07, 01, 07, 01, 07),
+    ['4'] = GLYPH(05, 05, 07, 01, 01), ['5'] = GLYPH(07, 04, 07, 01, 07),
+    ['6'] = GLYPH(07, 04, 07, 05, 07), ['7'] = GLYPH(07, 01, 01, 01, 01),
+    ['8'] = GLYPH(07, 05, 07, 05, 07), ['9'] = GLYPH(07, 05, 07, 01, 07),
+    ['A'] = GLYPH(02, 05, 07, 05, 05), ['B'] = GLYPH(06, 05, 06, 05, 06),
+    ['C'] = GLYPH(03, 04, 04, 04, 03), ['D'] = GLYPH(06, 05, 05, 05, 06),
+    ['E'] = GLYPH(07, 04, 06, 04, 07), ['F'] = GLYPH(07, 04, 06, 04, 04),
+    ['G'] = GLYPH(03, 04, 05, 05, 03), ['H'] = GLYPH(05, 05, 07, 05, 05),
+    ['I'] = GLYPH(07, 02, 02, 02, 07), ['J'] = GLYPH(01, 01, 01, 05, 02),
+    ['K'] = GLYPH(05, 05, 06, 05, 05), ['L'] = GLYPH(04, 04, 04, 04, 07),
+    ['M'] = GLYPH(05, 07, 07, 05, 05), ['N'] = GLYPH(06, 05, 05, 05, 05),
+    ['O'] = GLYPH(02, 05, 05, 05, 02), ['P'] = GLYPH(06, 05, 06, 04, 04),
+    ['Q'] = GLYPH(02, 05, 05, 06, 03), ['R'] = GLYPH(06, 05, 06, 05, 05),
+    ['S'] = GLYPH(03, 04, 02, 01, 06), ['T'] = GLYPH(07, 02, 02, 02, 02),
+    ['U'] = GLYPH(05, 05, 05, 05, 07), ['V'] = GLYPH(05, 05, 05, 05, 02),
+    ['W'] = GLYPH(05, 05, 07, 07, 05), ['X'] = GLYPH(05, 05, 02, 05, 05),
+    ['Y'] = GLYPH(05, 05, 02, 02, 02), ['Z'] = GLYPH(07, 01, 02, 04, 07),
+    ['.'] = GLYPH(00, 00, 00, 00, 02), ['-'] = GLYPH(00, 00, 07, 00, 00),
+    [':'] = GLYPH(00, 02, 00, 02, 00), ['/'] = GLYPH(01, 01, 02, 04, 04),
+    ['%'] = GLYPH(05, 01, 02, 04, 05),
+};
+
+void draw_text(const char *text, int x, int y, int scale, u32 color, u32 *pixels, int pix_buf_width) {
+    for (; *text; text++, x += TEXT_ADVANCE * scale) {
+        u8 c = *text;
+        if (c >= 'a' && c <= 'z') c -= 'a' - 'A';
+        u16 glyph = c < 128 ? glyphs[c] : 0;
+
+        for (int row = 0; row < 5; row++) {
+            for (int col = 0; col < 3; col++) {
+                if (!(glyph & (1 << (14 - row * 3 - col)))) continue;
+
+                for (int sy = 0; sy < scale; sy++) {
+                    pixels_fill(&pixels[(y + row * scale + sy) * pix_buf_width + x + col * scale], color, scale);
+                }
+            }
+        }
+    }
 }
 
 u32 *clone_pixels(u32 const * src, size_t len) {
-   u32 *p = malloc(len * (sizeof *p));
+   u32 *p = ALLOC(len * (sizeof *p));
    memcpy(p, src, len * (sizeof *p));
    return p;
 }
 
-inline u32 greyscale(u32 pix) {
-    u8 a = (pix >> 24) & 0xFF;
-    u8 b = (pix >> 16) & 0xFF;
-    u8 g = (pix >> 8) & 0xFF;
-    u8 r = pix & 0xFF;
-    u8 avg = (b + g + r) / 3;
-    return (a << 24) + (avg << 16) + (avg << 8) + avg;
+// single-pixel forms of the bulk kernels in pixel.c
+u32 greyscale(u32 pix) {
+    pixels_greyscale(&pix, &pix, 1);
+    return pix;
 }
 
-inline u32 darken(u32 pix) {
-    return (pix & 0x00fefefe) >> 1;
+u32 darken(u32 pix) {
+    pixels_darken(&pix, &pix, 1);
+    return pix;
 }
 
-inline u32 lighten(u32 pix) {
-    // Extract the alpha, blue, green, and red components
-    u8 alpha = (pix >> 24) & 0xFF;
-    u8 blue = (pix >> 16) & 0xFF;
-    u8 green = (pix >> 8) & 0xFF;
-    u8 red = pix & 0xFF;
+u32 lighten(u32 pix) {
+    pixels_lighten(&pix, &pix, 1);
+    return pix;
+}
+
+bool atlas_create(struct atlas *atlas, SDL_Renderer *renderer, sprite **sprites, u32 count) {
+    ASSERT(count <= ATLAS_MAX_SPRITES, "%u sprites exceed the atlas limit of %d\n", count, ATLAS_MAX_SPRITES);
+
+    // shelf packing: fill rows left to right, a row is as tall as its tallest sprite
+    int x = 0, y = 0, row_h = 0;
+
+    atlas->white = (SDL_Rect){.x = 0, .y = 0, .w = 4, .h = 4};
+    x = atlas->white.w;
+    row_h = atlas->white.h;
+
+    for (u32 i = 0; i < count; i++) {
+        int w = sprites[i]->width;
+        int h = sprites[i]->height;
+        if (x + w > ATLAS_WIDTH) {
+            x = 0;
+            y += row_h;
+            row_h = 0;
+        }
+        atlas->rects[i] = (SDL_Rect){.x = x, .y = y, .w = w, .h = h};
+        x += w;
+        if (h > row_h) row_h = h;
+    }
 
-    // Lighten the color by adding a fraction of the maximum value
-    red = (u8) ((255 - red) * 0.3 + red);
-    green = (u8) ((255 - green) * 0.4 + green);
-    blue = (u8) ((255 - blue) * 0.7 + blue);
+    atlas->count = count;
+    atlas->width = ATLAS_WIDTH;
+    atlas->height = y + row_h;
 
-    // Combine the components and return the new color
-    return ((u32)alpha << 24) | ((u32)blue << 16) | ((u32)green << 8) | (u32)red;
+    atlas->texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ABGR8888, SDL_TEXTUREACCESS_STATIC, atlas->width, atlas->height);
+    if (!atlas->texture) {
+        return false;
+    }
+    SDL_SetTextureBlendMode(atlas->texture, SDL_BLENDMODE_BLEND);
+
+    u32 white[4 * 4];
+    for (int i = 0; i < 4 * 4; i++) {
+        white[i] = 0xFFFFFFFF;
+    }
+    SDL_UpdateTexture(atlas->texture, &atlas->white, white, atlas->white.w * 4);
+
+    for (u32 i = 0; i < count; i++) {
+        SDL_UpdateTexture(atlas->texture, &atlas->rects[i], sprites[i]->pixels, sprites[i]->width * 4);
+    }
+
+    LOG("Built %dx%d sprite atlas from %u sprites", atlas->width, atlas->height, count);
+    return true;
+}
+
+void atlas_destroy(struct atlas *atlas) {
+    if (atlas->texture) {
+        SDL_DestroyTexture(atlas->texture);
+    }
+    atlas->texture = NULL;
+}
+
+void batch_begin(struct render_batch *batch, SDL_Renderer *renderer, struct atlas *atlas) {
+    batch->renderer = renderer;
+    batch->atlas = atlas;
+    batch->quads = 0;
+}
+
+static void batch_quad(struct render_batch *batch, SDL_Rect src, float inset, int x, int y, int w, int h, u32 color) {
+    if (batch->quads == BATCH_MAX_QUADS) {
+        batch_flush(batch);
+    }
+
+    float aw = batch->atlas->width;
+    float ah = batch->atlas->height;
+    float u0 = (src.x + inset) / aw, u1 = (src.x + src.w - inset) / aw;
+    float v0 = (src.y + inset) / ah, v1 = (src.y + src.h - inset) / ah;
+
+    SDL_Color c = {.r = color & 0xFF, .g = (color >> 8) & 0xFF, .b = (color >> 16) & 0xFF, .a = color >> 24};
+
+    SDL_Vertex *v = &batch->vertices[batch->quads * 4];
+    v[0] = (SDL_Vertex){.position = {x, y}, .color = c, .tex_coord = {u0, v0}};
+    v[1] = (SDL_Vertex){.position = {x + w, y}, .color = c, .tex_coord = {u1, v0}};
+    v[2] = (SDL_Vertex){.position = {x + w, y + h}, .color = c, .tex_coord = {u1, v1}};
+    v[3] = (SDL_Vertex){.position = {x, y + h}, .color = c, .tex_coord = {u0, v1}};
+
+    int base = batch->quads * 4;
+    int *idx = &batch->indices[batch->quads * 6];
+    idx[0] = base;
+    idx[1] = base + 1;
+    idx[2] = base + 2;
+    idx[3] = base;
+    idx[4] = base + 2;
+    idx[5] = base + 3;
+
+    batch->quads++;
+}
+
+void batch_sprite(struct render_batch *batch, u32 index, int x, int y, int w, int h) {
+    batch_quad(batch, batch->atlas->rects[index], 0.0f, x, y, w, h, 0xFFFFFFFF);
+}
+
+void batch_fill(struct render_batch *batch, int x, int y, int w, int h, u32 color) {
+    // sample well inside the white block so filtering never reaches a neighbour
+    batch_quad(batch, batch->atlas->white, 1.0f, x, y, w, h, color);
+}
+
+void batch_flush(struct render_batch *batch) {
+    if (batch->quads == 0) {
+        return;
+    }
+    SDL_RenderGeometry(batch->renderer, batch->atlas->texture,
+                       batch->vertices, batch->quads * 4,
+                       batch->indices, batch->quads * 6);
+    batch->quads = 0;
 }
@@ -0,0 +1,25 @@
+#include "../include/rng.h"
+
+static u64 splitmix64(u64 *x) {
+    return rng_mix(*x += 0x9e3779b97f4a7c15ull);
+}
+
+void rng_seed(struct rng *r, u64 seed) {
+    for (int i = 0; i < 4; i++) {
+        r->s[i] = splitmix64(&seed);
+    }
+}
+
+u32 rng_below(struct rng *r, u32 n) {
+    // Lemire's multiply-shift, rejecting the few low products that would bias it
+    u64 m = (rng_next(r) >> 32) * n;
+    u32 low = (u32)m;
+    if (low < n) {
+        u32 threshold = -n % n;
+        while (low < threshold) {
+            m = (rng_next(r) >> 32) * n;
+            low = (u32)m;
+        }
+    }
+    return m >> 32;
+}
@@ -0,0 +1,461 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/scene.h"
+#include "../include/alloc.h"
+#include "../include/macros.h"
+#include "../include/pixel.h"
+#include "../include/profile.h"
+
+void verline(int x, int y0, int y1, u32 color, u32* pixels, int pix_buf_width) {
+    for (int y = y0; y <= y1; y++)
+        pixels[(y * pix_buf_width) + x] = color;
+}
+
+void horiline(int x0, int x1, int y, u32 color, u32* pixels, int pix_buf_width) {
+    for (int x = x0; x <= x1; x++)
+        pixels[(y * pix_buf_width) + x] = color;
+}
+
+u32 flatten(u32 pix) {
+    u32 a = (pix >> 24) & 0xFF;
+    u32 b = (((pix >> 16) & 0xFF) * a + 127) / 255;
+    u32 g = (((pix >> 8) & 0xFF) * a + 127) / 255;
+    u32 r = ((pix & 0xFF) * a + 127) / 255;
+    return (0xFFu << 24) | (b << 16) | (g << 8) | r;
+}
+
+/*
+
+ DAMAGE
+
+*/
+static bool rect_empty(struct rect r) {
+    return r.w <= 0 || r.h <= 0;
+}
+
+static bool rect_overlaps(struct rect a, struct rect b) {
+    return a.x < b.x + b.w && b.x < a.x + a.w &&
+           a.y < b.y + b.h && b.y < a.y + a.h;
+}
+
+static bool rect_contains(struct rect outer, struct rect inner) {
+    return inner.x >= outer.x && inner.y >= outer.y &&
+           inner.x + inner.w <= outer.x + outer.w &&
+           inner.y + inner.h <= outer.y + outer.h;
+}
+
+static struct rect rect_union(struct rect a, struct rect b) {
+    int x0 = a.x < b.x ? a.x : b.x;
+    int y0 = a.y < b.y ? a.y : b.y;
+    int x1 = a.x + a.w > b.x + b.w ? a.x + a.w : b.x + b.w;
+    int y1 = a.y + a.h > b.y + b.h ? a.y + a.h : b.y + b.h;
+    return (struct rect){.x = x0, .y = y0, .w = x1 - x0, .h = y1 - y0};
+}
+
+void damage_clear(struct damage *d) {
+    d->count = 0;
+}
+
+bool damage_add(struct damage *d, struct rect r) {
+    // clip to the screen
+    if (r.x < 0) { r.w += r.x; r.x = 0; }
+    if (r.y < 0) { r.h += r.y; r.y = 0; }
+    if (r.x + r.w > SCREEN_WIDTH) r.w = SCREEN_WIDTH - r.x;
+    if (r.y + r.h > SCREEN_HEIGHT) r.h = SCREEN_HEIGHT - r.y;
+    if (rect_empty(r)) {
+        return false;
+    }
+
+    for (u32 i = 0; i < d->count; i++) {
+        if (rect_contains(d->rects[i], r)) {
+            return false;
+        }
+    }
+
+    // swallow every rect r overlaps, the union may overlap more so start over
+    for (u32 i = 0; i < d->count;) {
+        if (rect_overlaps(d->rects[i], r)) {
+            r = rect_union(r, d->rects[i]);
+            d->rects[i] = d->rects[--d->count];
+            i = 0;
+        } else {
+            i++;
+        }
+    }
+
+    if (d->count == DAMAGE_MAX_RECTS) {
+        // out of room, collapse everything into one bounding rect
+        for (u32 i = 0; i < d->count; i++) {
+            r = rect_union(r, d->rects[i]);
+        }
+        d->count = 0;
+    }
+
+    d->rects[d->count++] = r;
+    return true;
+}
+
+bool damage_intersects(const struct damage *d, struct rect r) {
+    for (u32 i = 0; i < d->count; i++) {
+        if (rect_overlaps(d->rects[i], r)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+
+ TILE SPRITES
+
+*/
+
+// stretch the tile's edge over its border on the side it is connected to
+static void extend_border(u32 *pixels, uint width, uint height, int connected) {
+    uint three_rows = (width * 3);
+    if (connected == CON_RIGHT) {
+        for (int i = three_rows + width - 3; i < (width * height) - three_rows; i += width) {
+            pixels[i] = (pixels[i - 3]);
+            pixels[i+1] = (pixels[i - 3]);
+            pixels[i+2] = (pixels[i - 3]);
+        }
+    } else if (connected == CON_LEFT) {
+        for (int i = three_rows; i < (width * height) - three_rows; i += width) {
+            pixels[i] = (pixels[i + 3]);
+            pixels[i+1] = (pixels[i + 3]);
+            pixels[i+2] = (pixels[i + 3]);
+        }
+    } else if (connected == CON_UP) {
+        for (int i = 3; i < three_rows; i++) {
+            pixels[i] = (pixels[i + three_rows]);
+            pixels[i+1] = (pixels[i + three_rows]);
+            pixels[i+2] = (pixels[i + three_rows]);
+        }
+    } else if (connected == CON_DOWN) {
+        // the last three rows become the three above them
+        for (uint y = height - 3; y < height; y++) {
+            memcpy(&pixels[y * width], &pixels[(y - 3) * width], sizeof(u32) * width);
+        }
+    }
+}
+
+static void bake_tile_variants(struct scene *s, int letter) {
+    sprite *base = &s->assets->sprites[ASSET_TILE('A' + letter)];
+    sprite *variants = s->tile_variants[letter];
+    usize size = base->width * base->height;
+
+    variants[CON_NONE] = *base;
+
+    for (int con = CON_UP; con <= CON_RIGHT; con++) {
+        u32 *pixels = ALLOC(sizeof(u32) * size);
+        ASSERT(pixels, "unable to allocate a tile variant\n");
+        memcpy(pixels, base->pixels, sizeof(u32) * size);
+        extend_border(pixels, base->width, base->height, con);
+        variants[con] = sprite_wrap(base->width, base->height, pixels);
+    }
+
+    variants[TILE_VARIANT_GREYED] = sprite_create_from(base->width, base->height, base->pixels);
+    pixels_greyscale(variants[TILE_VARIANT_GREYED].pixels, variants[TILE_VARIANT_GREYED].pixels, size);
+
+    // marked tiles shrink to half size and light up
+    sprite *marked = &variants[TILE_VARIANT_MARKED];
+    *marked = sprite_create(base->width / 2, base->height / 2, 0);
+    sprite_downscale(base, 2, marked);
+    pixels_lighten(marked->pixels, marked->pixels, marked->width * marked->height);
+}
+
+/*
+
+ DRAW LIST
+
+*/
+static u32 at(uint y, uint x, u32 width) {
+    return (y * width) + x;
+}
+
+static tile_t tile_create_empty() {
+    return (tile_t){
+        .letter='\0',
+        .marked=false,
+        .filled=false,
+        .connected=CON_NONE,
+        .pos={-1, -1},
+        .obj={},
+    };
+}
+
+static tile_t tile_create(struct scene *s, u8 letter, bool filled, bool marked, bool greyed, uint x, uint y) {
+    return (tile_t){
+        .letter = letter,
+        .filled = filled,
+        .marked = marked,
+        .greyed = greyed,
+        .connected = CON_NONE,
+        .pos = {x, y},
+        .obj = (obj_info_t){
+            .sprite = &s->assets->sprites[ASSET_TILE(letter)],
+            .pos = {x * TILE_SIZE + s->grid.pos.x, y * TILE_SIZE + s->grid.pos.y},
+            .size = {TILE_SIZE, TILE_SIZE},
+        },
+    };
+}
+
+static tile_t tile_from_game(struct scene *s, struct game_tile gt) {
+    tile_t t = tile_create(s, gt.letter, true, false, false, gt.pos.x, gt.pos.y);
+    t.connected = gt.connected;
+    return t;
+}
+
+// settled tiles slide down from where they were, speeding up like a fall
+static int tile_fall_offset(const struct game *g, double clock, u32 index) {
+    double elapsed = clock - g->time;
+    if (g->gravity != GRAVITY_SETTLE || g->fall[index] == 0 || elapsed >= FALL_ANIM_MS) {
+        return 0;
+    }
+
+    float progress = elapsed / FALL_ANIM_MS;
+    return -(int)(g->fall[index] * TILE_SIZE * (1.0f - progress * progress));
+}
+
+// rebuild the render views of the board, the falling pair and the queue
+static void grid_sync_tiles(struct scene *s, const struct game *g) {
+    const struct board *b = &g->board;
+
+    for (uint y = 0; y < s->rows; y++) {
+        for (uint x = 0; x < s->cols; x++) {
+            tile_t *t = &s->tiles[at(y, x, s->cols)];
+
+            if (!board_filled(b, x, y)) {
+                *t = (tile_t){.filled = false, .connected = CON_NONE, .pos = {x, y}};
+                continue;
+            }
+
+            *t = tile_create(s, board_letter(b, x, y), true, board_marked(b, x, y), board_greyed(b, x, y), x, y);
+            t->connected = board_connection(b, x, y);
+        }
+    }
+
+    s->player_active = g->player.active;
+    if (s->player_active) {
+        s->player[0] = tile_from_game(s, g->player.t1);
+        s->player[1] = tile_from_game(s, g->player.t2);
+    }
+
+    s->queue_tiles[0] = tile_from_game(s, g->queue[0]);
+    s->queue_tiles[1] = tile_from_game(s, g->queue[1]);
+}
+
+static int tile_variant(tile_t t) {
+    if (t.marked) return TILE_VARIANT_MARKED;
+    if (t.greyed) return TILE_VARIANT_GREYED;
+    return t.connected;
+}
+
+static struct draw_item tile_item(struct scene *s, tile_t t, int offset_y) {
+    int variant = tile_variant(t);
+    sprite *sp = &s->tile_variants[t.letter - 'A'][variant];
+    int x = t.pos.x * TILE_SIZE + s->grid.pos.x;
+    int y = t.pos.y * TILE_SIZE + s->grid.pos.y + offset_y;
+
+    // marked tiles are drawn shrunk in the middle of their cell
+    if (t.marked) {
+        x += 16;
+        y += 16;
+    }
+
+    return (struct draw_item){
+        .sprite = sp,
+        .atlas_index = ATLAS_TILE(t.letter - 'A', variant),
+        .dst = {.x = x, .y = y, .w = sp->width, .h = sp->height},
+    };
+}
+
+// fill s->items with everything on screen this frame, one fixed slot per
+// board cell followed by the queue and the falling pair
+static void build_draw_list(struct scene *s, const struct game *g, double clock) {
+    u32 cells = s->cols * s->rows;
+    struct draw_item *items = s->items;
+
+    grid_sync_tiles(s, g);
+
+    for (u32 i = 0; i < cells; i++) {
+        items[i] = s->tiles[i].filled ? tile_item(s, s->tiles[i], tile_fall_offset(g, clock, i)) : (struct draw_item){0};
+    }
+
+    items[cells + DRAW_QUEUE_BORDER] = (struct draw_item){
+        .sprite = s->queue.sprite,
+        .atlas_index = ATLAS_QUEUE_BORDER,
+        .dst = {.x = s->queue.pos.x, .y = s->queue.pos.y, .w = s->queue.size.x, .h = s->queue.size.y},
+    };
+
+    for (int i = 0; i < 2; i++) {
+        tile_t t = s->queue_tiles[i];
+        t.pos = (vec2i){0, 0};
+        struct draw_item item = tile_item(s, t, 0);
+        item.dst.x = s->queue.pos.x + TILE_SIZE / 2 + i * TILE_SIZE;
+        item.dst.y = s->queue.pos.y + TILE_SIZE / 2;
+        items[cells + DRAW_QUEUE_TILE + i] = item;
+    }
+
+    items[cells + DRAW_PLAYER] = s->player_active ? tile_item(s, s->player[0], 0) : (struct draw_item){0};
+    items[cells + DRAW_PLAYER + 1] = s->player_active ? tile_item(s, s->player[1], 0) : (struct draw_item){0};
+}
+
+// field by field, the padding after atlas_index is never written
+static bool draw_item_same(const struct draw_item *a, const struct draw_item *b) {
+    return a->sprite == b->sprite && a->atlas_index == b->atlas_index &&
+           a->dst.x == b->dst.x && a->dst.y == b->dst.y && a->dst.w == b->dst.w && a->dst.h == b->dst.h;
+}
+
+// damage every slot whose item moved, changed or disappeared since the last
+// presented frame
+static void collect_damage(struct scene *s) {
+    if (s->full) {
+        damage_add(&s->damage, (struct rect){.x = 0, .y = 0, .w = SCREEN_WIDTH, .h = SCREEN_HEIGHT});
+        return;
+    }
+
+    for (u32 i = 0; i < s->count; i++) {
+        struct draw_item *now = &s->items[i];
+        struct draw_item *was = &s->drawn[i];
+
+        if (draw_item_same(now, was)) continue;
+
+        if (was->sprite) damage_add(&s->damage, was->dst);
+        if (now->sprite) damage_add(&s->damage, now->dst);
+    }
+}
+
+/*
+
+ SOFTWARE COMPOSITING
+
+*/
+static void draw_bg(struct scene *s) {
+    PROFILE_SCOPE(PROFILE_DRAW_BG);
+    pixels_fill(s->background, flatten(BG_COLOR), SCREEN_WIDTH * SCREEN_HEIGHT);
+}
+
+static void draw_grid(struct scene *s) {
+    PROFILE_SCOPE(PROFILE_DRAW_GRID);
+    u32 line_color = flatten(GRID_LINE_COLOR);
+
+    int x = s->grid.pos.x;
+    int y = s->grid.pos.y;
+
+    for (int i = 0; i < (s->cols * TILE_SIZE) + 1; i += TILE_SIZE) {
+        verline(i + x, y, s->rows * TILE_SIZE + y, line_color, s->background, SCREEN_WIDTH);
+    }
+
+    for (int i = y; i < (s->rows * TILE_SIZE) + 1 + y; i += TILE_SIZE) {
+        horiline(x, (s->cols * TILE_SIZE) + x, i, line_color, s->background, SCREEN_WIDTH);
+    }
+}
+
+/*
+
+ SCENE
+
+*/
+void scene_init(struct scene *s, struct assets *assets, u32 cols, u32 rows) {
+    memset(s, 0, sizeof(*s));
+    s->assets = assets;
+
+    for (int i = 0; i < 26; i++) {
+        bake_tile_variants(s, i);
+    }
+
+    int grid_x = (SCREEN_WIDTH / 2) - ((10 * TILE_SIZE) / 2);
+    int grid_y = TILE_SIZE / 2;
+
+    s->cols = cols;
+    s->rows = rows;
+    s->tiles = ALLOC(rows * cols * sizeof(tile_t));
+    // Check if memory allocation was successful (not NULL)
+    ASSERT(s->tiles != NULL, "Memory allocation failed for tiles.\n");
+
+    for (uint i = 0; i < cols * rows; i++) {
+        s->tiles[i] = tile_create_empty();
+    }
+    s->count = rows * cols + DRAW_EXTRA_SLOTS;
+    s->items = CALLOC(s->count, sizeof(struct draw_item));
+    s->drawn = CALLOC(s->count, sizeof(struct draw_item));
+    ASSERT(s->items && s->drawn, "Memory allocation failed for the draw list.\n");
+    s->full = true;
+
+    s->grid = (obj_info_t){
+        .pos = {grid_x, grid_y},
+        .size = {cols * TILE_SIZE, rows * TILE_SIZE},
+    };
+
+    LOG("Creating queue...");
+    s->queue = (obj_info_t){
+        .size = {TILE_SIZE * 3, TILE_SIZE * 2},
+        .pos = {SCREEN_WIDTH - (3.25 * TILE_SIZE), TILE_SIZE / 2},
+        .sprite = &assets->sprites[ASSET_QUEUE_BORDER],
+    };
+    LOG("Queue created");
+
+    s->background = ALLOC(sizeof(u32) * SCREEN_WIDTH * SCREEN_HEIGHT);
+    s->screen = ALLOC(sizeof(u32) * SCREEN_WIDTH * SCREEN_HEIGHT);
+    ASSERT(s->background && s->screen, "Memory allocation failed for the screen buffers.\n");
+}
+
+void scene_destroy(struct scene *s) {
+    // CON_NONE is the loaded sprite itself
+    for (int i = 0; i < 26; i++) {
+        for (int v = CON_UP; v < TILE_VARIANT_COUNT; v++) {
+            free(s->tile_variants[i][v].pixels);
+        }
+    }
+
+    free(s->tiles);
+    free(s->items);
+    free(s->drawn);
+    free(s->background);
+    free(s->screen);
+}
+
+u32 scene_update(struct scene *s, const struct game *g, double clock) {
+    build_draw_list(s, g, clock);
+
+    damage_clear(&s->damage);
+    collect_damage(s);
+
+    return s->damage.count;
+}
+
+void scene_composite(struct scene *s) {
+    if (s->full) {
+        draw_bg(s);
+        draw_grid(s);
+    }
+
+    for (u32 i = 0; i < s->damage.count; i++) {
+        struct rect r = s->damage.rects[i];
+        u32 *window = &s->screen[r.y * SCREEN_WIDTH + r.x];
+
+        {
+            PROFILE_SCOPE(PROFILE_DRAW_RESTORE);
+            for (int y = 0; y < r.h; y++) {
+                memcpy(&window[y * SCREEN_WIDTH], &s->background[(r.y + y) * SCREEN_WIDTH + r.x], sizeof(u32) * r.w);
+            }
+        }
+
+        PROFILE_SCOPE(PROFILE_DRAW_TILES);
+        struct blit_target target = {.pixels = window, .width = r.w, .height = r.h, .stride = SCREEN_WIDTH};
+        for (u32 j = 0; j < s->count; j++) {
+            struct draw_item *item = &s->items[j];
+            if (item->sprite && rect_overlaps(r, item->dst)) {
+                sprite_blit(item->sprite, item->dst.x - r.x, item->dst.y - r.y, target, BLIT_PLAIN, BLIT_NO_TINT);
+            }
+        }
+    }
+}
+
+void scene_presented(struct scene *s) {
+    memcpy(s->drawn, s->items, s->count * sizeof(*s->items));
+    s->full = false;
+}
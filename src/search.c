@@ -0,0 +1,553 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/search.h"
+#include "../include/macros.h"
+
+// A pair state is t1's cell and the side t2 sits on, (cell << 2) | side.
+// Sides go clockwise from the right, the connection t1 holds. Cells are
+// y * GRID_MAX_DIM + x whatever the board's width, so a state splits into a
+// position with shifts instead of a division, and still orders by row then
+// column.
+static const u8 side_con[4] = {CON_RIGHT, CON_DOWN, CON_LEFT, CON_UP};
+static const vec2i side_offset[4] = {{1, 0}, {0, 1}, {-1, 0}, {0, -1}};
+
+// A rotation from each side: where it takes t1, relative to where t1 was,
+// and the side t2 ends up on. What game_pair_rotate_cw/ccw do before kicking,
+// clockwise first, and the column each of them kicks the pair over by.
+struct rotation {
+    vec2i t1;
+    u32 side;
+};
+
+static const struct rotation rotations[2][4] = {
+    {{{0, -1}, 1}, {{1, 1}, 2}, {{-1, 0}, 3}, {{0, 0}, 0}},
+    {{{1, 0}, 3}, {{-1, 1}, 0}, {{0, -1}, 1}, {{0, 0}, 2}},
+};
+static const int rotation_kick[2] = {-1, 1};
+
+static int side_of(u8 connected) {
+    switch (connected) {
+        case CON_RIGHT: return 0;
+        case CON_DOWN: return 1;
+        case CON_LEFT: return 2;
+        default: return 3;
+    }
+}
+
+static void pair_from_state(const struct board *b, u32 state, u8 l1, u8 l2, struct game_tile *t1, struct game_tile *t2) {
+    u32 side = state & 3;
+    u32 cell = state >> 2;
+
+    t1->letter = l1;
+    t1->pos = (vec2i){cell % GRID_MAX_DIM, cell / GRID_MAX_DIM};
+    t1->connected = side_con[side];
+
+    t2->letter = l2;
+    t2->pos = (vec2i){t1->pos.x + side_offset[side].x, t1->pos.y + side_offset[side].y};
+    t2->connected = side_con[(side + 2) & 3];
+}
+
+// the columns of b as bits of a row mask
+static inline u64 board_columns(const struct board *b) {
+    return b->width >= 64 ? ~0ull : (1ull << b->width) - 1;
+}
+
+// Bit x is set if (x + dx, y) is filled or off b, what board_filled says of
+// it, for every column x of b. Shifting the row rather than the cells keeps
+// every bit of a result on the board, so it can be shifted back unclipped.
+static inline u64 blocked_at(const struct board *b, int y, int dx) {
+    if (y < 0 || y >= (int)b->height) {
+        return ~0ull;
+    }
+
+    u64 row = b->filled[y] | ~board_columns(b);
+    return dx >= 0 ? row >> dx | ~(~0ull >> dx) : row << -dx | ((1ull << -dx) - 1);
+}
+
+// bits x of b's columns for which x + dx is off the board on the side a kick
+// of k moves away from, where a rotation is kicked without looking at tiles
+static inline u64 beyond(const struct board *b, int dx, int k) {
+    u64 columns = board_columns(b);
+    if (k < 0) {
+        return dx > 0 ? columns & ~(columns >> dx) : 0;
+    }
+    return dx < 0 ? columns & ((1ull << -dx) - 1) : 0;
+}
+
+// bits x to bits x + dx
+static inline u64 shift_columns(u64 bits, int dx) {
+    return dx >= 0 ? bits << dx : bits >> -dx;
+}
+
+// the bits of open that a walk left and right within open reaches from
+// reach, spread by doubling distances so a row takes log2(width) steps
+static inline u64 spread(u64 reach, u64 open, u32 width) {
+    u64 left = reach, right = reach;
+    u64 open_left = open, open_right = open;
+
+    for (u32 n = 1; n < width; n <<= 1) {
+        right |= open_right & (right << n);
+        open_right &= open_right << n;
+        left |= open_left & (left >> n);
+        open_left &= open_left >> n;
+    }
+
+    return left | right;
+}
+
+// blocked_at from s->blocked, for the rows and columns next to a row that
+// moves and rotations look at
+static inline u64 blocked_near(const struct search *s, int y, int dx) {
+    return s->blocked[dx + 2][y + 1];
+}
+
+// Everything find_landings needs to know of b: where each pair fits, and
+// which states each rotation turns in place and which it turns kicked, what
+// game_pair_rotate_cw/ccw decide for them.
+static void map_board(struct search *s, const struct board *b) {
+    int height = b->height;
+
+    // rows above the stack all look the same, the one below them aside
+    int top = 0;
+    while (top < height && !b->filled[top]) top++;
+
+    for (int dx = -2; dx <= 2; dx++) {
+        for (int y = -1; y <= height; y++) {
+            s->blocked[dx + 2][y + 1] = blocked_at(b, y, dx);
+        }
+    }
+
+    for (u32 side = 0; side < 4; side++) {
+        for (int y = 0; y < height; y++) {
+            s->fits[side][y] = ~blocked_near(s, y, 0) & ~blocked_near(s, y + side_offset[side].y, side_offset[side].x);
+        }
+    }
+
+    for (int dir = 0; dir < 2; dir++) {
+        int k = rotation_kick[dir];
+
+        for (u32 side = 0; side < 4; side++) {
+            vec2i p = rotations[dir][side].t1;
+            vec2i q = vector_add(p, side_offset[rotations[dir][side].side]);
+            u64 off_board = beyond(b, p.x, k) | beyond(b, q.x, k);
+
+            for (int y = 0; y < height; y++) {
+                if (y >= 2 && y + 1 < top) {
+                    s->turns[dir][side][y] = s->turns[dir][side][y - 1];
+                    s->kicks[dir][side][y] = s->kicks[dir][side][y - 1];
+                    continue;
+                }
+
+                // t1 and t2 where the rotation puts them, and one kick over
+                u64 p_blocked = blocked_near(s, y + p.y, p.x);
+                u64 q_blocked = blocked_near(s, y + q.y, q.x);
+                u64 p_kicked = blocked_near(s, y + p.y, p.x + k);
+                u64 q_kicked = blocked_near(s, y + q.y, q.x + k);
+
+                u64 kick = (q_blocked & ~q_kicked) | (p_blocked & ~p_kicked) | off_board;
+                s->turns[dir][side][y] = ~kick & ~p_blocked & ~q_blocked;
+                s->kicks[dir][side][y] = kick & ~p_kicked & ~q_kicked;
+            }
+        }
+    }
+}
+
+// Follow the rotations of the states of row y on side that haven't been
+// rotated yet into s->reach. True if that reached anything new.
+static bool rotate_row(struct search *s, int y, u32 side) {
+    u64 fresh = s->reach[side][y] & ~s->rotated[side][y];
+    bool grew = false;
+
+    s->rotated[side][y] |= fresh;
+
+    for (int dir = 0; dir < 2; dir++) {
+        vec2i p = rotations[dir][side].t1;
+        u64 reached = shift_columns(fresh & s->turns[dir][side][y], p.x) |
+                      shift_columns(fresh & s->kicks[dir][side][y], p.x + rotation_kick[dir]);
+
+        // nothing left means the row may be off the board, it is never touched
+        if (reached) {
+            u64 *row = &s->reach[rotations[dir][side].side][y + p.y];
+            grew |= (reached & ~*row) != 0;
+            *row |= reached;
+        }
+    }
+
+    return grew;
+}
+
+// Find every state the pair can be moved to from t1, t2 and keep those it
+// can't fall from, where a drop lands it. A landing and its mirror, t1 on the
+// other cell and t2 on the opposite side, are the same placement once flipped,
+// so only the first of the two is kept. Returns how many there are, in state
+// order.
+//
+// States are walked a row of cells at a time, as bitboards per side: the
+// states the pair fits in, and those reached so far. Shifts spread along a
+// row, the fall carries a row down to the next, and the rotations map every
+// state of a row and side onto another side at once, kicks included. Rows are
+// swept until the rotations reach nothing new.
+static u32 find_landings(struct search *s, const struct board *b, struct game_tile t1, struct game_tile t2, u16 *landings) {
+    u32 height = b->height;
+
+    // a pair overlapping the stack has nowhere to go
+    if (board_filled(b, t1.pos.x, t1.pos.y) || board_filled(b, t2.pos.x, t2.pos.y)) {
+        return 0;
+    }
+
+    map_board(s, b);
+    for (u32 side = 0; side < 4; side++) {
+        memset(s->reach[side], 0, sizeof(u64) * height);
+        memset(s->rotated[side], 0, sizeof(u64) * height);
+    }
+    s->reach[side_of(t1.connected)][t1.pos.y] = 1ull << t1.pos.x;
+
+    bool grew = true;
+    while (grew) {
+        grew = false;
+
+        for (u32 side = 0; side < 4; side++) {
+            for (u32 y = 0; y < height; y++) {
+                u64 reach = s->reach[side][y];
+                if (y > 0) reach |= s->reach[side][y - 1] & s->fits[side][y];
+                if (reach) s->reach[side][y] = spread(reach, s->fits[side][y], b->width);
+            }
+        }
+
+        for (u32 side = 0; side < 4; side++) {
+            for (u32 y = 0; y < height; y++) {
+                if (s->reach[side][y] != s->rotated[side][y]) {
+                    grew |= rotate_row(s, y, side);
+                }
+            }
+        }
+    }
+
+    u32 count = 0;
+    for (u32 y = 0; y < height; y++) {
+        u64 lands[4];
+        for (u32 side = 0; side < 4; side++) {
+            lands[side] = s->reach[side][y] & ~(y + 1 < height ? s->fits[side][y + 1] : 0);
+        }
+
+        // a mirror has the same cells, so it lands too if it was reached,
+        // and it comes first if t2 is left of or above t1
+        lands[2] &= ~(s->reach[0][y] << 1);
+        lands[3] &= ~(y > 0 ? s->reach[1][y - 1] : 0);
+
+        for (u64 any = lands[0] | lands[1] | lands[2] | lands[3]; any; any &= any - 1) {
+            u32 x = __builtin_ctzll(any);
+            for (u32 side = 0; side < 4; side++) {
+                if ((lands[side] >> x) & 1) {
+                    landings[count++] = ((y * GRID_MAX_DIM + x) << 2) | side;
+                }
+            }
+        }
+    }
+
+    return count;
+}
+
+// rows from the highest tile down to the floor
+static u32 stack_height(const struct board *b) {
+    for (u32 y = 0; y < b->height; y++) {
+        if (b->filled[y]) return b->height - y;
+    }
+    return 0;
+}
+
+// land t1, t2 on a copy of b in out and run what game_update does until the
+// next pair spawns: scan, clear and let everything fall, as long as words turn up
+static void play_out(struct search *s, const struct board *b, const struct game_tile *t1, const struct game_tile *t2,
+                     struct board *out, struct search_placement *p) {
+    board_copy(out, b);
+    board_set(out, t1->pos.x, t1->pos.y, t1->letter, false, t1->connected);
+    board_set(out, t2->pos.x, t2->pos.y, t2->letter, false, t2->connected);
+
+    *p = (struct search_placement){.t1 = *t1, .t2 = *t2};
+    board_update_connections(out);
+
+    // A settle leaves everything at rest in one pass and moves pairs whole,
+    // so every connection still matches after it. Only a clear breaks them.
+    bool at_rest = false;
+
+    for (;;) {
+        if (!board_scan_for_words(out, s->dict, s->lines)) {
+            // nothing to clear, but whatever moves gets scanned again
+            if (at_rest || !board_settle(out, NULL)) break;
+            at_rest = true;
+            continue;
+        }
+
+        p->words += out->found_count;
+        p->chain++;
+        for (u32 y = 0; y < out->height; y++) {
+            p->tiles += __builtin_popcountll(out->marked[y] & out->filled[y]);
+        }
+
+        board_clear_marked(out);
+        board_update_connections(out);
+        board_settle(out, NULL);
+        at_rest = true;
+    }
+
+    p->height = stack_height(out);
+    s->evaluated++;
+}
+
+// keep a copy of b for the landings of this ply to be scanned on, if nothing
+// on it would move and none of its lines holds a word
+static void prepare_rest(struct search *s, int ply, const struct board *b) {
+    struct board *rest = &s->rest[ply];
+
+    board_copy(rest, b);
+    s->at_rest[ply] = !board_update_connections(rest) && !board_settle(rest, NULL) &&
+                      !board_lines_hold_word(rest, s->dict, s->lines, rest->dirty_rows, rest->dirty_cols);
+    s->rest_height[ply] = stack_height(rest);
+}
+
+// The outcome of landing t1, t2 when it clears nothing. The pair is set on
+// the resting board and the runs of tiles through it are scanned, as the
+// board's lines held no word before, then the pair is taken off again. False
+// if the board isn't at rest or a word turns up, then the landing has to be
+// played out.
+static bool land_quietly(struct search *s, int ply, const struct game_tile *t1, const struct game_tile *t2,
+                         struct search_placement *p) {
+    struct board *b = &s->rest[ply];
+    if (!s->at_rest[ply]) {
+        return false;
+    }
+
+    // the scan only reads occupancy and letters, so that is all the pair sets
+    u64 *row1 = &b->filled[t1->pos.y];
+    u64 *row2 = &b->filled[t2->pos.y];
+    u8 *letter1 = &b->letters[t1->pos.y * b->width + t1->pos.x];
+    u8 *letter2 = &b->letters[t2->pos.y * b->width + t2->pos.x];
+    u64 before1 = *row1;
+    u64 before2 = *row2;
+    u8 was1 = *letter1;
+    u8 was2 = *letter2;
+
+    *row1 |= 1ull << t1->pos.x;
+    *row2 |= 1ull << t2->pos.x;
+    *letter1 = t1->letter;
+    *letter2 = t2->letter;
+
+    // the line through both halves once, and each half across it
+    bool across = t1->pos.y == t2->pos.y;
+    bool word = board_run_holds_word(b, s->dict, s->lines, t1->pos.x, t1->pos.y, !across) ||
+                board_run_holds_word(b, s->dict, s->lines, t1->pos.x, t1->pos.y, across) ||
+                board_run_holds_word(b, s->dict, s->lines, t2->pos.x, t2->pos.y, across);
+
+    *letter2 = was2;
+    *letter1 = was1;
+    *row1 = before1;
+    *row2 = before2;
+
+    if (word) {
+        return false;
+    }
+
+    int top = t1->pos.y < t2->pos.y ? t1->pos.y : t2->pos.y;
+    u32 height = b->height - top;
+
+    *p = (struct search_placement){.t1 = *t1, .t2 = *t2};
+    p->height = height > s->rest_height[ply] ? height : s->rest_height[ply];
+    s->evaluated++;
+
+    return true;
+}
+
+// Table keys: the board's hash with the lines still to scan, which decide
+// what a scan finds, and what kind of result is stored.
+#define KEY_LANDING 1
+#define KEY_LOOKAHEAD 2
+
+static u64 table_key(u64 hash, u64 dirty_rows, u64 dirty_cols, u64 kind) {
+    return rng_mix(hash ^ rng_mix(dirty_rows ^ rng_mix(dirty_cols ^ rng_mix(kind))));
+}
+
+// the key of b with t1, t2 landed on it, without landing them
+static u64 landing_key(const struct board *b, const struct game_tile *t1, const struct game_tile *t2) {
+    u64 hash = b->hash ^ board_zobrist(t1->pos.x, t1->pos.y, t1->letter, false, t1->connected) ^
+               board_zobrist(t2->pos.x, t2->pos.y, t2->letter, false, t2->connected);
+    u64 rows = b->dirty_rows | (1ull << t1->pos.y) | (1ull << t2->pos.y);
+    u64 cols = b->dirty_cols | (1ull << t1->pos.x) | (1ull << t2->pos.x);
+
+    return table_key(hash, rows, cols, KEY_LANDING);
+}
+
+// p's outcome as 16 bit fields: words, tiles, chain, height
+static u64 pack_outcome(const struct search_placement *p) {
+    return (u64)p->words | (u64)p->tiles << 16 | (u64)p->chain << 32 | (u64)p->height << 48;
+}
+
+static void unpack_outcome(u64 data, struct search_placement *p) {
+    p->words = data & 0xFFFF;
+    p->tiles = (data >> 16) & 0xFFFF;
+    p->chain = (data >> 32) & 0xFFFF;
+    p->height = data >> 48;
+}
+
+// play_out when only the outcome is needed. A quiet landing is cheaper to
+// scan than to probe for, otherwise it comes from the table if it is there.
+static void evaluate(struct search *s, int ply, const struct board *b, const struct game_tile *t1,
+                     const struct game_tile *t2, struct search_placement *p) {
+    struct board *scratch = &s->boards[ply];
+
+    if (land_quietly(s, ply, t1, t2, p)) {
+        return;
+    }
+
+    if (!s->table) {
+        play_out(s, b, t1, t2, scratch, p);
+        return;
+    }
+
+    u64 key = landing_key(b, t1, t2);
+    u64 data;
+    if (ttable_probe(s->table, key, &data)) {
+        *p = (struct search_placement){.t1 = *t1, .t2 = *t2};
+        unpack_outcome(data, p);
+        return;
+    }
+
+    play_out(s, b, t1, t2, scratch, p);
+    ttable_store(s->table, key, pack_outcome(p));
+}
+
+// -1 if a ranks before b, ignoring the lookahead
+static int compare_outcome(const struct search_placement *a, const struct search_placement *b) {
+    if (a->words != b->words) return a->words > b->words ? -1 : 1;
+    if (a->tiles != b->tiles) return a->tiles > b->tiles ? -1 : 1;
+    if (a->height != b->height) return a->height < b->height ? -1 : 1;
+    return 0;
+}
+
+static int compare_placements(const void *a, const void *b) {
+    return compare_outcome(a, b);
+}
+
+// -1 if a ranks before b, with the lookahead
+static int compare_lookahead(const struct search_placement *a, const struct search_placement *b) {
+    if (a->blocks_spawn != b->blocks_spawn) return a->blocks_spawn ? 1 : -1;
+
+    u32 total_a = a->words + a->next_words;
+    u32 total_b = b->words + b->next_words;
+    if (total_a != total_b) return total_a > total_b ? -1 : 1;
+
+    return compare_outcome(a, b);
+}
+
+void search_init(struct search *s, struct dict_trie *dict) {
+    memset(s, 0, sizeof(*s));
+    s->dict = dict;
+}
+
+u32 search_placements(struct search *s, const struct board *b, struct game_tile t1, struct game_tile t2,
+                      struct search_placement *out, u32 capacity) {
+    u32 landings = find_landings(s, b, t1, t2, s->landings[0]);
+    u32 count = 0;
+
+    if (landings) {
+        prepare_rest(s, 0, b);
+    }
+
+    for (u32 i = 0; i < landings; i++) {
+        for (int flip = 0; flip < 2 && count < capacity; flip++) {
+            // the flip only matters if the letters differ
+            if (flip && t1.letter == t2.letter) continue;
+
+            struct game_tile a, c;
+            pair_from_state(b, s->landings[0][i], flip ? t2.letter : t1.letter, flip ? t1.letter : t2.letter, &a, &c);
+            evaluate(s, 0, b, &a, &c, &out[count++]);
+        }
+    }
+
+    return count;
+}
+
+void search_sort(struct search_placement *placements, u32 count) {
+    qsort(placements, count, sizeof(*placements), compare_placements);
+}
+
+// fill in p's lookahead: the best the queued pair can clear on the board p left
+static void look_ahead(struct search *s, const struct game *g, struct search_placement *p) {
+    const struct board *b = &s->boards[0];
+    struct game_tile q1 = g->queue[0];
+    struct game_tile q2 = g->queue[1];
+
+    // the same board and queued letters always look ahead the same
+    u64 key = 0;
+    u64 data;
+    if (s->table) {
+        key = table_key(b->hash ^ rng_mix((u64)q1.letter << 8 | q2.letter), b->dirty_rows, b->dirty_cols, KEY_LOOKAHEAD);
+        if (ttable_probe(s->table, key, &data)) {
+            p->next_words = data & 0xFFFFFFFF;
+            p->blocks_spawn = data >> 32;
+            return;
+        }
+    }
+
+    p->next_words = 0;
+    p->blocks_spawn = !game_pair_spawn(b, &q1, &q2);
+    if (p->blocks_spawn) {
+        if (s->table) ttable_store(s->table, key, 1ull << 32);
+        return;
+    }
+
+    u32 landings = find_landings(s, b, q1, q2, s->landings[1]);
+    if (landings) {
+        prepare_rest(s, 1, b);
+    }
+
+    for (u32 i = 0; i < landings; i++) {
+        for (int flip = 0; flip < 2; flip++) {
+            if (flip && q1.letter == q2.letter) continue;
+
+            struct game_tile a, c;
+            struct search_placement next;
+            pair_from_state(b, s->landings[1][i], flip ? q2.letter : q1.letter, flip ? q1.letter : q2.letter, &a, &c);
+            evaluate(s, 1, b, &a, &c, &next);
+
+            if (next.words > p->next_words) {
+                p->next_words = next.words;
+            }
+        }
+    }
+
+    if (s->table) ttable_store(s->table, key, p->next_words);
+}
+
+bool search_best(struct search *s, const struct game *g, struct search_placement *best) {
+    if (!g->player.active) {
+        return false;
+    }
+
+    const struct board *b = &g->board;
+    struct game_tile t1 = g->player.t1;
+    struct game_tile t2 = g->player.t2;
+    bool found = false;
+
+    u32 landings = find_landings(s, b, t1, t2, s->landings[0]);
+    for (u32 i = 0; i < landings; i++) {
+        for (int flip = 0; flip < 2; flip++) {
+            if (flip && t1.letter == t2.letter) continue;
+
+            struct game_tile a, c;
+            struct search_placement p;
+            pair_from_state(b, s->landings[0][i], flip ? t2.letter : t1.letter, flip ? t1.letter : t2.letter, &a, &c);
+            play_out(s, b, &a, &c, &s->boards[0], &p);
+            look_ahead(s, g, &p);
+
+            if (!found || compare_lookahead(&p, best) < 0) {
+                *best = p;
+                found = true;
+            }
+        }
+    }
+
+    return found;
+}
@@ -0,0 +1,149 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/sim.h"
+#include "../include/macros.h"
+
+// hand the current state to the reader, taking back whichever slot it left
+static void sim_publish(struct sim *sim) {
+    struct sim_snapshot *s = &sim->snapshots[sim->back];
+    memcpy(&s->game, sim->game, sizeof(s->game));
+    s->clock = sim->clock;
+    s->wall = sim->wall - sim->accumulator;
+    s->inputs = atomic_load_explicit(&sim->command_tail, memory_order_relaxed);
+
+    u32 prev = atomic_exchange_explicit(&sim->middle, sim->back | SIM_SNAPSHOT_FRESH, memory_order_acq_rel);
+    sim->back = prev & ~SIM_SNAPSHOT_FRESH;
+}
+
+// pass the game's events on to the reader
+static void sim_collect_events(struct sim *sim) {
+    if (sim->game->events) {
+        atomic_fetch_or_explicit(&sim->events, sim->game->events, memory_order_relaxed);
+        sim->game->events = 0;
+    }
+}
+
+void sim_init(struct sim *sim, struct game *g, double now) {
+    memset(sim, 0, sizeof(*sim));
+    sim->game = g;
+    sim->clock = g->time;
+    sim->wall = now;
+
+    sim->back = 0;
+    atomic_init(&sim->middle, 1);
+    sim->front = 2;
+
+    sim_publish(sim);
+}
+
+bool sim_push(struct sim *sim, enum sim_command command, double time) {
+    u32 head = atomic_load_explicit(&sim->command_head, memory_order_relaxed);
+    u32 tail = atomic_load_explicit(&sim->command_tail, memory_order_acquire);
+    if (head - tail == SIM_COMMAND_CAPACITY) {
+        return false;
+    }
+
+    sim->inputs[head & (SIM_COMMAND_CAPACITY - 1)] = (struct sim_input){.command = command, .time = time};
+    atomic_store_explicit(&sim->command_head, head + 1, memory_order_release);
+
+    return true;
+}
+
+// apply command as of simulation time `at`
+static void sim_apply(struct sim *sim, enum sim_command command, double at) {
+    struct game *g = sim->game;
+
+    switch (command) {
+        case SIM_SHIFT_LEFT:
+            game_player_shift(g, -1);
+            break;
+        case SIM_SHIFT_RIGHT:
+            game_player_shift(g, 1);
+            break;
+        case SIM_DROP:
+            // a late command must not wind the tick clock back
+            game_player_drop(g, at > g->time ? at : g->time);
+            break;
+        case SIM_ROTATE_CW:
+            game_player_rotate_cw(g);
+            break;
+        case SIM_ROTATE_CCW:
+            game_player_rotate_ccw(g);
+            break;
+        case SIM_FLIP:
+            game_player_flip(g);
+            break;
+        case SIM_QUIT:
+            g->status = QUIT;
+            break;
+    }
+}
+
+bool sim_advance(struct sim *sim, double now) {
+    if (sim->game->status == QUIT) {
+        return false;
+    }
+
+    sim->accumulator += now - sim->wall;
+    sim->wall = now;
+    if (sim->accumulator > SIM_MAX_CATCHUP_MS) {
+        sim->accumulator = SIM_MAX_CATCHUP_MS;
+    }
+
+    // simulation time of a wall time, commands lost in a dropped stall land now
+    double start = sim->clock;
+    double start_wall = now - sim->accumulator;
+
+    u32 tail = atomic_load_explicit(&sim->command_tail, memory_order_relaxed);
+    u32 head = atomic_load_explicit(&sim->command_head, memory_order_acquire);
+    bool changed = false;
+
+    for (;;) {
+        bool due = sim->accumulator >= SIM_STEP_MS;
+
+        // everything that happened before the next step, or all that is left
+        for (; tail != head; tail++) {
+            struct sim_input *in = &sim->inputs[tail & (SIM_COMMAND_CAPACITY - 1)];
+            double at = start + (in->time - start_wall);
+            if (due && at > sim->clock + SIM_STEP_MS) break;
+
+            sim_apply(sim, in->command, at);
+            changed = true;
+        }
+
+        // a quit among the commands ends the game before the step
+        if (!due || sim->game->status == QUIT) break;
+
+        sim->accumulator -= SIM_STEP_MS;
+        sim->clock += SIM_STEP_MS;
+        changed |= game_step(sim->game, sim->clock);
+    }
+
+    atomic_store_explicit(&sim->command_tail, tail, memory_order_release);
+
+    if (changed) {
+        sim_collect_events(sim);
+        sim_publish(sim);
+    }
+
+    return sim->game->status != QUIT;
+}
+
+double sim_until_step(const struct sim *sim) {
+    return SIM_STEP_MS - sim->accumulator;
+}
+
+const struct sim_snapshot *sim_snapshot(struct sim *sim) {
+    if (atomic_load_explicit(&sim->middle, memory_order_acquire) & SIM_SNAPSHOT_FRESH) {
+        u32 prev = atomic_exchange_explicit(&sim->middle, sim->front, memory_order_acq_rel);
+        sim->front = prev & ~SIM_SNAPSHOT_FRESH;
+    }
+
+    return &sim->snapshots[sim->front];
+}
+
+u32 sim_take_events(struct sim *sim) {
+    return atomic_exchange_explicit(&sim->events, 0, memory_order_relaxed);
+}
@@ -1,45 +1,215 @@
 
 #include "../include/sprite.h"
 #include "../include/macros.h"
+#include "../include/alloc.h"
+#include "../include/pixel.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
-void sprite_push_to_buf(sprite sp, int x, int y, u32 *buf, u32 buf_width, u32 buf_height) {
-    for (int i = 0; i < sp.width * sp.height; i++) {
-        int screen_x = (i % sp.width) + x;
-        int screen_y = (i / sp.width) + y;
-        int index = screen_y * buf_width + screen_x;
-        buf[index] = sp.pixels[i];
+// x * y / 255, rounded
+static inline u32 mul255(u32 x, u32 y) {
+    u32 t = x * y + 128;
+    return (t + (t >> 8)) >> 8;
+}
+
+// every channel of p times f / 255, rounded, two channels per multiply
+static inline u32 scale_channels(u32 p, u32 f) {
+    u32 rb = (p & 0x00FF00FF) * f + 0x00800080;
+    rb = ((rb + ((rb >> 8) & 0x00FF00FF)) >> 8) & 0x00FF00FF;
+    u32 ag = ((p >> 8) & 0x00FF00FF) * f + 0x00800080;
+    ag = (ag + ((ag >> 8) & 0x00FF00FF)) & 0xFF00FF00;
+    return rb | ag;
+}
+
+// source-over of straight-alpha src onto dst, premultiplying src as it goes
+static void blend_row(u32 *dst, const u32 *src, usize count) {
+    for (usize i = 0; i < count; i++) {
+        u32 s = src[i];
+        u32 a = s >> 24;
+        if (a == 0xFF) {
+            dst[i] = s;
+        } else if (a != 0) {
+            u32 premultiplied = (scale_channels(s, a) & 0x00FFFFFF) | (a << 24);
+            dst[i] = premultiplied + scale_channels(dst[i], 0xFF - a);
+        }
     }
 }
 
+static void tint_row(u32 *pixels, usize count, u32 tint) {
+    u32 r = tint & 0xFF, g = (tint >> 8) & 0xFF, b = (tint >> 16) & 0xFF, a = tint >> 24;
+    for (usize i = 0; i < count; i++) {
+        u32 p = pixels[i];
+        pixels[i] = mul255(p & 0xFF, r) | (mul255((p >> 8) & 0xFF, g) << 8) |
+                    (mul255((p >> 16) & 0xFF, b) << 16) | (mul255(p >> 24, a) << 24);
+    }
+}
+
+void sprite_blit(const sprite *sp, int x, int y, struct blit_target dst, enum blit_filter filter, u32 tint) {
+    // the part of the sprite that lands inside dst
+    int x0 = x < 0 ? -x : 0;
+    int y0 = y < 0 ? -y : 0;
+    int x1 = x + (int)sp->width > dst.width ? dst.width - x : (int)sp->width;
+    int y1 = y + (int)sp->height > dst.height ? dst.height - y : (int)sp->height;
+    if (x0 >= x1 || y0 >= y1) return;
+
+    usize w = x1 - x0;
+    bool transformed = filter != BLIT_PLAIN || tint != BLIT_NO_TINT;
+    // a translucent tint leaves nothing to copy
+    bool copy = (tint >> 24) == 0xFF;
+
+    // one row of filtered pixels, kept in cache between the passes over it
+    u32 row[SPRITE_MAX_W];
+
+    for (int sy = y0; sy < y1; sy++) {
+        const u32 *src = &sp->pixels[sy * sp->width + x0];
+        u32 *out = &dst.pixels[(y + sy) * dst.stride + x + x0];
+
+        if (transformed) {
+            if (filter == BLIT_GREYSCALE) {
+                pixels_greyscale(row, src, w);
+            } else if (filter == BLIT_LIGHTEN) {
+                pixels_lighten(row, src, w);
+            } else {
+                memcpy(row, src, sizeof(u32) * w);
+            }
+            if (tint != BLIT_NO_TINT) {
+                tint_row(row, w, tint);
+            }
+            src = row;
+        }
+
+        // the part of the row's opaque span inside dst
+        int from = copy ? sp->opaque_from[sy] : x1;
+        int to = copy ? sp->opaque_to[sy] : x1;
+        if (from < x0) from = x0;
+        if (from > x1) from = x1;
+        if (to > x1) to = x1;
+        if (to < from) to = from;
+
+        blend_row(out, src, from - x0);
+        memcpy(&out[from - x0], &src[from - x0], sizeof(u32) * (to - from));
+        blend_row(&out[to - x0], &src[to - x0], x1 - to);
+    }
+}
+
+void sprite_push_to_buf(sprite sp, int x, int y, u32 *buf, u32 buf_width, u32 buf_height) {
+    struct blit_target dst = {.pixels = buf, .width = buf_width, .height = buf_height, .stride = buf_width};
+    sprite_blit(&sp, x, y, dst, BLIT_PLAIN, BLIT_NO_TINT);
+}
+
 sprite sprite_create(usize w, usize h, u32 color) {
     sprite sp;
     ASSERT(w < SPRITE_MAX_W && h < SPRITE_MAX_H, "%zu or %zu exceeds max sprite width %d or height %d", w, h, SPRITE_MAX_W, SPRITE_MAX_H);
-    sp.pixels = malloc(sizeof(u32) * w * h);
-    LOG("sprite can hold = %lu pixels", (sizeof(u32) * w * h) / 4);
+    sp.pixels = ALLOC(sizeof(u32) * w * h);
     sp.width = w;
     sp.height = h;
-    for (int i = 0; i < w * h; i++) {
-        sp.pixels[i] = color;
-    }
+    pixels_fill(sp.pixels, color, w * h);
+    sprite_find_opaque(&sp);
 
     return sp;
 }
 
 sprite sprite_create_from(usize w, usize h, u32* pixels) {
     sprite sp;
+    ASSERT(w <= SPRITE_MAX_W && h <= SPRITE_MAX_H, "%zux%zu sprite exceeds the %dx%d maximum\n", w, h, SPRITE_MAX_W, SPRITE_MAX_H);
     sp.width = w;
     sp.height = h;
-    sp.pixels = malloc(sizeof(u32) * w * h);
-    LOG("sprite pixels can hold = %lu", (sizeof(u32) * w * h) / 4);
+    sp.pixels = ALLOC(sizeof(u32) * w * h);
     for (int i = 0; i < w*h; i++) {
         sp.pixels[i] = pixels[i];
     }
+    sprite_find_opaque(&sp);
 
     return sp;
 }
 
+sprite sprite_wrap(usize w, usize h, u32 *pixels) {
+    ASSERT(w <= SPRITE_MAX_W && h <= SPRITE_MAX_H, "%zux%zu sprite exceeds the %dx%d maximum\n", w, h, SPRITE_MAX_W, SPRITE_MAX_H);
+    sprite sp = {.width = w, .height = h, .pixels = pixels};
+    sprite_find_opaque(&sp);
+    return sp;
+}
+
+void sprite_find_opaque(sprite *sp) {
+    for (usize y = 0; y < sp->height; y++) {
+        const u32 *row = &sp->pixels[y * sp->width];
+        usize best_from = 0, best_to = 0, from = 0;
+
+        for (usize x = 0; x <= sp->width; x++) {
+            if (x == sp->width || (row[x] >> 24) != 0xFF) {
+                if (x - from > best_to - best_from) {
+                    best_from = from;
+                    best_to = x;
+                }
+                from = x + 1;
+            }
+        }
+
+        sp->opaque_from[y] = best_from;
+        sp->opaque_to[y] = best_to;
+    }
+}
+
+void sprite_downscale(const sprite *sp, u32 factor, sprite *dst) {
+    ASSERT(factor > 0, "cannot downscale by a factor of 0\n");
+    ASSERT(dst->width == sp->width / factor && dst->height == sp->height / factor,
+           "%zux%zu sprite cannot hold %zux%zu downscaled by %u\n", dst->width, dst->height, sp->width, sp->height, factor);
+
+    usize w = dst->width;
+    usize h = dst->height;
+
+    if (factor == 1) {
+        memcpy(dst->pixels, sp->pixels, sizeof(u32) * w * h);
+        sprite_find_opaque(dst);
+        return;
+    }
+
+    if (factor == 2) {
+        for (usize y = 0; y < h; y++) {
+            const u32 *row0 = &sp->pixels[(2 * y) * sp->width];
+            pixels_halve_rows(&dst->pixels[y * w], row0, row0 + sp->width, w);
+        }
+        sprite_find_opaque(dst);
+        return;
+    }
+
+    // per-channel sums down each source column of a block of rows, then
+    // across each run of factor columns
+    u32 columns[SPRITE_MAX_W * 4];
+    usize src_w = w * factor;
+    u32 area = factor * factor;
+
+    for (usize y = 0; y < h; y++) {
+        memset(columns, 0, sizeof(u32) * src_w * 4);
+
+        for (u32 r = 0; r < factor; r++) {
+            const u32 *row = &sp->pixels[(y * factor + r) * sp->width];
+            for (usize x = 0; x < src_w; x++) {
+                columns[x * 4 + 0] += row[x] & 0xFF;
+                columns[x * 4 + 1] += (row[x] >> 8) & 0xFF;
+                columns[x * 4 + 2] += (row[x] >> 16) & 0xFF;
+                columns[x * 4 + 3] += row[x] >> 24;
+            }
+        }
+
+        u32 *out = &dst->pixels[y * w];
+        for (usize x = 0; x < w; x++) {
+            u32 sum[4] = {0};
+            for (u32 c = 0; c < factor; c++) {
+                const u32 *col = &columns[(x * factor + c) * 4];
+                sum[0] += col[0];
+                sum[1] += col[1];
+                sum[2] += col[2];
+                sum[3] += col[3];
+            }
+            out[x] = (sum[0] / area) | ((sum[1] / area) << 8) | ((sum[2] / area) << 16) | ((sum[3] / area) << 24);
+        }
+    }
+
+    sprite_find_opaque(dst);
+}
+
 void sprite_pixel_color(sprite *sp, int x, int y, u32 color) {
     sp->pixels[(x * sp->width) + y] = color;
 }
@@ -0,0 +1,57 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../include/stats.h"
+#include "../include/alloc.h"
+#include "../include/macros.h"
+
+void samples_init(struct samples *s) {
+    s->values = NULL;
+    s->count = 0;
+    s->capacity = 0;
+    s->sorted = true;
+}
+
+void samples_destroy(struct samples *s) {
+    free(s->values);
+    samples_init(s);
+}
+
+void samples_reserve(struct samples *s, u32 capacity) {
+    if (capacity > s->capacity) {
+        s->capacity = capacity;
+        s->values = REALLOC(s->values, sizeof(double) * s->capacity);
+        ASSERT(s->values, "unable to grow samples to %u\n", s->capacity);
+    }
+}
+
+void samples_add(struct samples *s, double value) {
+    if (s->count == s->capacity) {
+        samples_reserve(s, s->capacity ? s->capacity * 2 : 256);
+    }
+
+    s->values[s->count++] = value;
+    s->sorted = false;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+double samples_percentile(struct samples *s, double p) {
+    if (s->count == 0) {
+        return 0;
+    }
+
+    if (!s->sorted) {
+        qsort(s->values, s->count, sizeof(double), compare_doubles);
+        s->sorted = true;
+    }
+
+    // nearest rank: the smallest rank covering p percent, rounded up
+    double exact = p / 100.0 * s->count;
+    u32 rank = (u32)exact;
+    if (rank < exact) rank++;
+    return s->values[rank > 0 ? rank - 1 : 0];
+}
@@ -2,52 +2,245 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "../include/trie.h"
 #include "../include/tile.h"
 #include "../include/macros.h"
+#include "../include/alloc.h"
+#include "../include/profile.h"
+#include "../include/rng.h"
 
-struct dict_trie_node* trie_node_create() {
-    struct dict_trie_node* node = (struct dict_trie_node*)malloc(sizeof(struct dict_trie_node));
+struct dict_trie* trie_create() {
+    struct dict_trie* dict = (struct dict_trie*)ALLOC(sizeof(struct dict_trie));
+    ASSERT(dict, "unable to allocate dictionary");
 
-    for (int i = 0; i < MAX_CHILDREN; i++) {
-        node->children[i] = NULL;
-    }
+    dict->nodes = NULL;
+    dict->node_count = 0;
+
+    dict->map = NULL;
+    dict->map_size = 0;
 
-    node->is_end_of_word = false;
+    dict->build = NULL;
+    dict->build_count = 0;
+    dict->build_capacity = 0;
 
-    return node;
+    return dict;
 }
 
-void trie_destroy(struct dict_trie_node* node) {
-    if (node == NULL) {
+// drop the compact nodes, whether they were allocated or mapped
+static void trie_release_nodes(struct dict_trie* dict) {
+    if (dict->map) {
+        munmap(dict->map, dict->map_size);
+        dict->map = NULL;
+        dict->map_size = 0;
+    } else {
+        free(dict->nodes);
+    }
+
+    dict->nodes = NULL;
+    dict->node_count = 0;
+}
+
+void trie_destroy(struct dict_trie* dict) {
+    if (dict == NULL) {
         return;
     }
 
-    for (int i = 0; i < 26; i++) {
-        trie_destroy(node->children[i]);
+    trie_release_nodes(dict);
+    free(dict->build);
+    free(dict);
+}
+
+static u32 build_node_create(struct dict_trie* dict, u8 letter) {
+    if (dict->build_count == dict->build_capacity) {
+        dict->build_capacity = dict->build_capacity ? dict->build_capacity * 2 : 1024;
+        dict->build = REALLOC(dict->build, dict->build_capacity * sizeof(struct dict_build_node));
+        ASSERT(dict->build, "unable to grow dictionary staging trie to %u nodes", dict->build_capacity);
     }
 
-    free(node);
+    u32 n = dict->build_count++;
+    dict->build[n] = (struct dict_build_node){
+        .child = 0,
+        .sibling = 0,
+        .letter = letter,
+        .is_end_of_word = false,
+    };
+
+    return n;
 }
 
-void trie_insert_word(struct dict_trie_node* root, const char* word) {
-    struct dict_trie_node* curr = root;
+// expand a compacted node back into the staging trie below `parent`
+static void thaw_node(struct dict_trie* dict, struct dict_node node, u32 parent) {
+    u32 prev = 0;
+
+    for (u32 i = 0; i < MAX_CHILDREN; i++) {
+        if (!(node.mask & (1u << i))) {
+            continue;
+        }
+
+        struct dict_node child = dict->nodes[node.first + __builtin_popcount(node.mask & ((1u << i) - 1))];
+        u32 n = build_node_create(dict, i);
+        dict->build[n].is_end_of_word = child.mask & DICT_END_OF_WORD;
+
+        if (prev) {
+            dict->build[prev].sibling = n;
+        } else {
+            dict->build[parent].child = n;
+        }
+        prev = n;
+
+        thaw_node(dict, child, n);
+    }
+}
+
+// make sure the staging trie exists, unpacking the compact form if needed
+static void trie_thaw(struct dict_trie* dict) {
+    if (dict->build) {
+        return;
+    }
+
+    u32 root = build_node_create(dict, 0);
+
+    if (dict->nodes) {
+        dict->build[root].is_end_of_word = dict->nodes[0].mask & DICT_END_OF_WORD;
+        thaw_node(dict, dict->nodes[0], root);
+
+        trie_release_nodes(dict);
+    }
+}
+
+void trie_insert_word(struct dict_trie* dict, const char* word) {
+    trie_thaw(dict);
+
+    u32 curr = 0;
 
     for (int i = 0; word[i] != '\0'; i++) {
-        int index = word[i] - 'a'; // Convert character to index (assuming only lowercase alphabets)
+        u32 index = (u8)word[i] - 'a'; // Convert character to index (assuming only lowercase alphabets)
 
-        if (curr->children[index] == NULL) {
-            curr->children[index] = trie_node_create();
+        if (index >= MAX_CHILDREN) {
+            return;
         }
 
-        curr = curr->children[index];
+        // siblings are kept sorted so trie_compact can emit them in letter order
+        u32 prev = 0;
+        u32 next = dict->build[curr].child;
+        while (next && dict->build[next].letter < index) {
+            prev = next;
+            next = dict->build[next].sibling;
+        }
+
+        if (!next || dict->build[next].letter != index) {
+            u32 n = build_node_create(dict, index);
+            dict->build[n].sibling = next;
+
+            if (prev) {
+                dict->build[prev].sibling = n;
+            } else {
+                dict->build[curr].child = n;
+            }
+            next = n;
+        }
+
+        curr = next;
+    }
+
+    dict->build[curr].is_end_of_word = true;
+}
+
+struct block_table {
+    u32 *offsets; // 0 marks an empty slot, otherwise index into dict->nodes
+    u8 *lengths;
+    u32 mask;
+};
+
+static u32 block_hash(const struct dict_node* block, u32 count) {
+    u32 h = 2166136261u;
+    for (u32 i = 0; i < count; i++) {
+        h = (h ^ block[i].mask) * 16777619u;
+        h = (h ^ block[i].first) * 16777619u;
+    }
+    return h;
+}
+
+// store a block of sibling nodes, reusing an identical block if one exists
+static u32 intern_block(struct dict_trie* dict, struct block_table* table, const struct dict_node* block, u32 count) {
+    u32 slot = block_hash(block, count) & table->mask;
+
+    while (table->offsets[slot]) {
+        u32 offset = table->offsets[slot];
+        if (table->lengths[slot] == count &&
+            memcmp(&dict->nodes[offset], block, count * sizeof(struct dict_node)) == 0) {
+            return offset;
+        }
+        slot = (slot + 1) & table->mask;
     }
 
-    curr->is_end_of_word = true;
+    u32 offset = dict->node_count;
+    memcpy(&dict->nodes[offset], block, count * sizeof(struct dict_node));
+    dict->node_count += count;
+
+    table->offsets[slot] = offset;
+    table->lengths[slot] = count;
+
+    return offset;
 }
 
-int trie_construct(struct dict_trie_node* root, const char* dict_file) {
+static struct dict_node compact_node(struct dict_trie* dict, struct block_table* table, u32 n) {
+    struct dict_node block[MAX_CHILDREN];
+    u32 count = 0;
+    u32 mask = dict->build[n].is_end_of_word ? DICT_END_OF_WORD : 0;
+
+    for (u32 child = dict->build[n].child; child; child = dict->build[child].sibling) {
+        block[count++] = compact_node(dict, table, child);
+        mask |= 1u << dict->build[child].letter;
+    }
+
+    return (struct dict_node){
+        .mask = mask,
+        .first = count ? intern_block(dict, table, block, count) : 0,
+    };
+}
+
+void trie_compact(struct dict_trie* dict) {
+    if (dict->build == NULL) {
+        return;
+    }
+
+    // every staging node yields at most one compact node, plus the root slot
+    dict->nodes = ALLOC((dict->build_count + 1) * sizeof(struct dict_node));
+    ASSERT(dict->nodes, "unable to allocate %u dictionary nodes", dict->build_count + 1);
+    dict->node_count = 1;
+
+    u32 table_size = 1024;
+    while (table_size < dict->build_count * 2) {
+        table_size *= 2;
+    }
+
+    struct block_table table = {
+        .offsets = CALLOC(table_size, sizeof(u32)),
+        .lengths = ALLOC(table_size),
+        .mask = table_size - 1,
+    };
+    ASSERT(table.offsets && table.lengths, "unable to allocate dictionary block table");
+
+    dict->nodes[0] = compact_node(dict, &table, 0);
+
+    free(table.offsets);
+    free(table.lengths);
+
+    free(dict->build);
+    dict->build = NULL;
+    dict->build_count = 0;
+    dict->build_capacity = 0;
+
+    dict->nodes = REALLOC(dict->nodes, dict->node_count * sizeof(struct dict_node));
+}
+
+int trie_construct(struct dict_trie* dict, const char* dict_file) {
     LOG("Construct dict trie");
     FILE* file = fopen(dict_file, "r");
 
@@ -59,30 +252,207 @@ int trie_construct(struct dict_trie_node* root, const char* dict_file) {
         // Remove newline character from the word, if present
         word[strcspn(word, "\n")] = '\0';
 
-        trie_insert_word(root, word);
+        trie_insert_word(dict, word);
     }
 
     fclose(file);
 
+    trie_compact(dict);
+    LOG("Dict trie compacted to %u nodes (%zu bytes)", dict->node_count, dict->node_count * sizeof(struct dict_node));
+
     return 0;
 }
 
-bool trie_search_word(struct dict_trie_node* root, const char* word) {
-    struct dict_trie_node* curr = root;
+// FNV-1a over the whole file, used to tell whether an image matches its source
+static int file_checksum(const char* file_name, u32* checksum) {
+    FILE* file = fopen(file_name, "rb");
+    if (file == NULL) {
+        return -1;
+    }
 
-    for (int i = 0; word[i] != '\0'; i++) {
-        int index = word[i] - 'a'; // Convert character to index (assuming only lowercase alphabets)
+    u32 h = 2166136261u;
+    u8 buf[1 << 14];
+    usize n;
 
-        if (curr->children[index] == NULL) {
-            return false; // Word does not exist
+    while ((n = fread(buf, 1, sizeof(buf), file)) > 0) {
+        for (usize i = 0; i < n; i++) {
+            h = (h ^ buf[i]) * 16777619u;
+        }
+    }
+
+    fclose(file);
+    *checksum = h;
+
+    return 0;
+}
+
+// an image is fresh if its source is unchanged, or missing altogether
+static bool image_is_fresh(const struct dict_image_header* header, const char* dict_file) {
+    struct stat st;
+    if (stat(dict_file, &st) != 0) {
+        return true;
+    }
+
+    if ((u64)st.st_size != header->source_size) {
+        return false;
+    }
+
+    // a matching mtime is trusted, otherwise the contents decide
+    if ((i64)st.st_mtime == header->source_mtime) {
+        return true;
+    }
+
+    u32 checksum;
+    return file_checksum(dict_file, &checksum) == 0 && checksum == header->source_checksum;
+}
+
+// every node's child block lies inside the image, so trie_step can't read past it
+static bool image_children_in_bounds(const struct dict_node* nodes, u32 node_count) {
+    for (u32 i = 0; i < node_count; i++) {
+        u64 children = __builtin_popcount(nodes[i].mask & ((1u << MAX_CHILDREN) - 1));
+        if (nodes[i].first + children > node_count) {
+            return false;
         }
+    }
+
+    return true;
+}
+
+int trie_load_image(struct dict_trie* dict, const char* image_file, const char* dict_file) {
+    int fd = open(image_file, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (usize)st.st_size < sizeof(struct dict_image_header)) {
+        close(fd);
+        return -1;
+    }
+
+    usize size = st.st_size;
+    void* map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
 
-        curr = curr->children[index];
+    if (map == MAP_FAILED) {
+        return -1;
     }
 
-    return (curr != NULL && curr->is_end_of_word);
+    const struct dict_image_header* header = map;
+
+    if (header->magic != DICT_IMAGE_MAGIC ||
+        header->version != DICT_IMAGE_VERSION ||
+        header->node_count == 0 ||
+        size != sizeof(struct dict_image_header) + (usize)header->node_count * sizeof(struct dict_node) ||
+        !image_children_in_bounds((const struct dict_node*)(header + 1), header->node_count)) {
+        LOG("Dictionary image %s is malformed", image_file);
+        munmap(map, size);
+        return -1;
+    }
+
+    if (!image_is_fresh(header, dict_file)) {
+        LOG("Dictionary image %s is stale", image_file);
+        munmap(map, size);
+        return -1;
+    }
+
+    trie_release_nodes(dict);
+    free(dict->build);
+    dict->build = NULL;
+    dict->build_count = 0;
+    dict->build_capacity = 0;
+
+    dict->map = map;
+    dict->map_size = size;
+    dict->nodes = (struct dict_node*)(header + 1);
+    dict->node_count = header->node_count;
+
+    LOG("Mapped dictionary image %s (%u nodes)", image_file, dict->node_count);
+
+    return 0;
 }
 
+int trie_write_image(struct dict_trie* dict, const char* image_file, const char* dict_file) {
+    trie_compact(dict);
+
+    struct stat st;
+    struct dict_image_header header = {
+        .magic = DICT_IMAGE_MAGIC,
+        .version = DICT_IMAGE_VERSION,
+        .node_count = dict->node_count,
+    };
+
+    if (stat(dict_file, &st) != 0 || file_checksum(dict_file, &header.source_checksum) != 0) {
+        return -1;
+    }
+    header.source_size = st.st_size;
+    header.source_mtime = st.st_mtime;
+
+    FILE* file = fopen(image_file, "wb");
+    if (file == NULL) {
+        return -1;
+    }
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+              fwrite(dict->nodes, sizeof(struct dict_node), dict->node_count, file) == dict->node_count;
+
+    return (fclose(file) == 0 && ok) ? 0 : -1;
+}
+
+int trie_load(struct dict_trie* dict, const char* image_file, const char* dict_file) {
+    if (trie_load_image(dict, image_file, dict_file) == 0) {
+        return 0;
+    }
+
+    return trie_construct(dict, dict_file);
+}
+
+// follow `letter` from node in the compacted trie, false if no word continues with it
+static inline bool trie_step(const struct dict_trie* dict, struct dict_node* node, char letter) {
+    u32 index = (u8)letter - 'a'; // Convert character to index (assuming only lowercase alphabets)
+
+    if (index >= MAX_CHILDREN || !(node->mask & (1u << index))) {
+        return false;
+    }
+
+    *node = dict->nodes[node->first + __builtin_popcount(node->mask & ((1u << index) - 1))];
+    return true;
+}
+
+bool trie_search_word(struct dict_trie* dict, const char* word) {
+    if (dict->build) {
+        u32 curr = 0;
+
+        for (int i = 0; word[i] != '\0'; i++) {
+            u32 index = (u8)word[i] - 'a';
+
+            curr = dict->build[curr].child;
+            while (curr && dict->build[curr].letter < index) {
+                curr = dict->build[curr].sibling;
+            }
+
+            if (!curr || dict->build[curr].letter != index) {
+                return false; // Word does not exist
+            }
+        }
+
+        return dict->build[curr].is_end_of_word;
+    }
+
+    if (dict->nodes == NULL) {
+        return false;
+    }
+
+    struct dict_node curr = dict->nodes[0];
+
+    for (int i = 0; word[i] != '\0'; i++) {
+        if (!trie_step(dict, &curr, word[i])) {
+            return false; // Word does not exist
+        }
+    }
+
+    return curr.mask & DICT_END_OF_WORD;
+}
 
 // word is viable if it contains and vowel and a consonant
 const bool check_word_viability(char* word) {
@@ -121,6 +491,157 @@ const bool check_string_validity(const char* substring) {
 }
 
 
+bool trie_longest_word(struct dict_trie* dict, const char* str, int len, int max_len, int* start, int* end) {
+    int longest = 0;
+    bool found = false;
+
+    trie_compact(dict);
+    if (dict->nodes == NULL) {
+        return false;
+    }
+
+    // Walk the trie once from every start position. Only a strictly longer
+    // word replaces the current one, so the leftmost of the longest words wins.
+    for (int i = 0; i + longest < len; i++) {
+        struct dict_node node = dict->nodes[0];
+        bool contains_vowel = false;
+        bool contains_consonant = false;
+
+        for (int j = i; j < len && j - i < max_len; j++) {
+            if (str[j] == ' ' || !trie_step(dict, &node, str[j])) {
+                break;
+            }
+
+            switch(str[j]) {
+                case 'a': case 'e': case 'i': case 'o': case 'u':
+                    contains_vowel = true;
+                    break;
+                default:
+                    contains_consonant = true;
+                    break;
+            }
+
+            int sub_len = j - i + 1;
+            if (sub_len >= 3 && sub_len > longest &&
+                (node.mask & DICT_END_OF_WORD) && contains_vowel && contains_consonant) {
+                longest = sub_len;
+                *start = i;
+                *end = j + 1;
+                found = true;
+            }
+        }
+    }
+
+    return found;
+}
+
+// A slot holds the key in bits 0-53, bit 54 set if a word was found, its
+// start in 55-58 and end in 59-62, and bit 63 set in every used slot so an
+// empty slot is 0.
+#define LINE_KEY_MASK ((1ull << 54) - 1)
+#define LINE_FOUND (1ull << 54)
+#define LINE_USED (1ull << 63)
+
+void line_cache_init(struct line_cache* cache) {
+    cache->slots = CALLOC(LINE_CACHE_SLOTS, sizeof(u64));
+    ASSERT(cache->slots, "unable to allocate the line cache\n");
+    cache->hits = 0;
+    cache->misses = 0;
+}
+
+void line_cache_destroy(struct line_cache* cache) {
+    free(cache->slots);
+    cache->slots = NULL;
+}
+
+void line_cache_clear(struct line_cache* cache) {
+    memset(cache->slots, 0, LINE_CACHE_SLOTS * sizeof(u64));
+    cache->hits = 0;
+    cache->misses = 0;
+}
+
+bool line_cache_lookup(struct line_cache* cache, u64 key, bool* found, int* start, int* end) {
+    u32 home = rng_mix(key) & (LINE_CACHE_SLOTS - 1);
+
+    for (u32 i = 0; i < LINE_CACHE_PROBES; i++) {
+        u64 slot = cache->slots[(home + i) & (LINE_CACHE_SLOTS - 1)];
+
+        // nothing is ever removed alone, so the line would have been stored here
+        if (slot == 0) {
+            break;
+        }
+
+        if ((slot & LINE_KEY_MASK) == key) {
+            cache->hits++;
+            PROFILE_COUNT(PROFILE_LINE_CACHE_HITS);
+            *found = slot & LINE_FOUND;
+            if (*found) {
+                *start = (slot >> 55) & 15;
+                *end = (slot >> 59) & 15;
+            }
+            return true;
+        }
+    }
+
+    cache->misses++;
+    PROFILE_COUNT(PROFILE_LINE_CACHE_MISSES);
+    return false;
+}
+
+void line_cache_store(struct line_cache* cache, u64 key, bool found, int start, int end) {
+    u32 home = rng_mix(key) & (LINE_CACHE_SLOTS - 1);
+    u32 index = home;
+
+    // the first free slot, or the first one when every probe is taken
+    for (u32 i = 0; i < LINE_CACHE_PROBES; i++) {
+        u32 probe = (home + i) & (LINE_CACHE_SLOTS - 1);
+        if (cache->slots[probe] == 0) {
+            index = probe;
+            break;
+        }
+    }
+
+    u64 slot = key | LINE_USED;
+    if (found) {
+        slot |= LINE_FOUND | (u64)start << 55 | (u64)end << 59;
+    }
+    cache->slots[index] = slot;
+}
+
+double line_cache_hit_rate(const struct line_cache* cache) {
+    u64 lookups = cache->hits + cache->misses;
+    return lookups ? (double)cache->hits / lookups : 0.0;
+}
+
+bool trie_longest_line(struct dict_trie* dict, struct line_cache* cache, const char* str, int len, int max_len, int* start, int* end) {
+    if (cache == NULL || len > LINE_CACHE_MAX_LEN) {
+        return trie_longest_word(dict, str, len, max_len, start, end);
+    }
+
+    u64 codes = 0;
+    u64 cells = 0;
+    for (int i = 0; i < len; i++) {
+        u64 code = trie_line_code(str[i]);
+        codes |= code << (5 * i);
+        cells |= (u64)(code != 0) << i;
+    }
+
+    if (!trie_line_may_hold_word(cells, max_len)) {
+        return false;
+    }
+
+    u64 key = trie_line_key(codes, max_len);
+    bool found;
+    if (line_cache_lookup(cache, key, &found, start, end)) {
+        return found;
+    }
+
+    found = trie_longest_word(dict, str, len, max_len, start, end);
+    line_cache_store(cache, key, found, found ? *start : 0, found ? *end : 0);
+
+    return found;
+}
+
 // check for words in a given row of characters
 const bool check_substrings(
     const char* str,
@@ -128,38 +649,16 @@ const bool check_substrings(
     tile_t *tiles,
     usize grid_w,
     usize grid_h,
-    struct dict_trie_node *dict)
+    struct dict_trie *dict,
+    struct line_cache *cache)
 {
     int len = strlen(str);
     int max_len = len < grid_h ? len : grid_h;
 
-    int longest = 0;
     int index_start = -1;
     int index_end = -1;
 
-    bool found = false;
-
-    for (int sub_len = max_len; sub_len >= 3; sub_len--) {
-        for (int i = 0; i <= len - sub_len; i++) {
-            char substr[sub_len + 1];
-            strncpy(substr, str + i, sub_len);
-            substr[sub_len] = '\0';
-
-
-            if (check_word_viability(substr) && check_string_validity(substr)) {
-                if (trie_search_word(dict, substr)) {
-                    if (sub_len > longest) {
-                        longest = sub_len;
-                        index_start = i;
-                        index_end = i + sub_len;
-                        found = true;
-                    }
-
-                    break;
-                }
-            }
-        }
-    }
+    bool found = trie_longest_line(dict, cache, str, len, max_len, &index_start, &index_end);
 
     for (int x = index_start; x < index_end; x++) {
         // IFDEBUG_LOG("Marked %d", indices[x]);
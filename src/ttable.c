@@ -0,0 +1,64 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/ttable.h"
+#include "../include/alloc.h"
+#include "../include/macros.h"
+
+void ttable_init(struct ttable *t, u32 bits) {
+    ASSERT(bits < 40, "a table of 2^%u entries is too large\n", bits);
+
+    u64 count = 1ull << bits;
+    t->entries = CALLOC(count, sizeof(struct ttable_entry));
+    ASSERT(t->entries, "unable to allocate a table of %llu entries\n", (unsigned long long)count);
+    t->mask = count - 1;
+
+    atomic_init(&t->probes, 0);
+    atomic_init(&t->hits, 0);
+}
+
+void ttable_destroy(struct ttable *t) {
+    free(t->entries);
+    t->entries = NULL;
+}
+
+void ttable_clear(struct ttable *t) {
+    // an all zero slot reads as key 0 with data 0, keys are mixed hashes
+    // that practically never are 0
+    memset(t->entries, 0, (t->mask + 1) * sizeof(struct ttable_entry));
+    atomic_store_explicit(&t->probes, 0, memory_order_relaxed);
+    atomic_store_explicit(&t->hits, 0, memory_order_relaxed);
+}
+
+// keys are hashes, so their low bits already spread over the table
+static struct ttable_entry *slot(struct ttable *t, u64 key) {
+    return &t->entries[key & t->mask];
+}
+
+bool ttable_probe(struct ttable *t, u64 key, u64 *data) {
+    struct ttable_entry *e = slot(t, key);
+    u64 check = atomic_load_explicit(&e->check, memory_order_relaxed);
+    u64 value = atomic_load_explicit(&e->data, memory_order_relaxed);
+
+    bool hit = (check ^ value) == key;
+    atomic_fetch_add_explicit(&t->probes, 1, memory_order_relaxed);
+    if (hit) {
+        atomic_fetch_add_explicit(&t->hits, 1, memory_order_relaxed);
+        *data = value;
+    }
+
+    return hit;
+}
+
+void ttable_store(struct ttable *t, u64 key, u64 data) {
+    struct ttable_entry *e = slot(t, key);
+    atomic_store_explicit(&e->check, key ^ data, memory_order_relaxed);
+    atomic_store_explicit(&e->data, data, memory_order_relaxed);
+}
+
+double ttable_hit_rate(const struct ttable *t) {
+    u64 probes = atomic_load_explicit(&t->probes, memory_order_relaxed);
+    u64 hits = atomic_load_explicit(&t->hits, memory_order_relaxed);
+    return probes ? (double)hits / probes : 0.0;
+}
@@ -0,0 +1,185 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+#include "../include/workers.h"
+#include "../include/alloc.h"
+#include "../include/macros.h"
+#include "../include/rng.h"
+
+// one thread's jobs, filled before the threads start and only taken from after
+struct worker_deque {
+    _Atomic i64 top;
+    _Atomic i64 bottom;
+    u32 *jobs;
+};
+
+struct worker {
+    struct workers_pool *pool;
+    u32 index;
+    pthread_t thread;
+
+    struct worker_deque deque;
+    // picks steal victims, each thread has its own
+    struct rng rng;
+    u64 steals;
+};
+
+struct workers_pool {
+    struct worker *workers;
+    u32 count;
+
+    worker_job_fn fn;
+    void *arg;
+};
+
+// no job to hand out, or lost a race for the last one
+#define JOB_NONE UINT32_MAX
+// a steal lost to another thread, the deque may still hold jobs
+#define JOB_RETRY (UINT32_MAX - 1)
+
+// take the newest job of the thread's own deque
+static u32 deque_pop(struct worker_deque *d) {
+    // claim the bottom slot before looking at top, seq_cst so a thief can't
+    // see the old bottom and the new top at once
+    i64 b = atomic_load_explicit(&d->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&d->bottom, b, memory_order_seq_cst);
+    i64 t = atomic_load_explicit(&d->top, memory_order_seq_cst);
+
+    if (t > b) {
+        // already empty, undo the claim
+        atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+        return JOB_NONE;
+    }
+
+    u32 job = d->jobs[b];
+    if (t == b) {
+        // the last job, thieves may be after it too
+        if (!atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed)) {
+            job = JOB_NONE;
+        }
+        atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+    }
+
+    return job;
+}
+
+// take the oldest job of another thread's deque
+static u32 deque_steal(struct worker_deque *d) {
+    i64 t = atomic_load_explicit(&d->top, memory_order_seq_cst);
+    i64 b = atomic_load_explicit(&d->bottom, memory_order_seq_cst);
+
+    if (t >= b) {
+        return JOB_NONE;
+    }
+
+    u32 job = d->jobs[t];
+    if (!atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed)) {
+        return JOB_RETRY;
+    }
+
+    return job;
+}
+
+// steal from the others starting at a random one, JOB_NONE once every deque
+// was seen empty in one pass. Jobs never spawn jobs, so then there is no work left.
+static u32 worker_steal(struct worker *w) {
+    struct workers_pool *pool = w->pool;
+
+    for (;;) {
+        bool contended = false;
+        u32 first = rng_below(&w->rng, pool->count);
+
+        for (u32 i = 0; i < pool->count; i++) {
+            struct worker *victim = &pool->workers[(first + i) % pool->count];
+            if (victim == w) continue;
+
+            u32 job = deque_steal(&victim->deque);
+            if (job == JOB_RETRY) {
+                contended = true;
+            } else if (job != JOB_NONE) {
+                w->steals++;
+                return job;
+            }
+        }
+
+        if (!contended) {
+            return JOB_NONE;
+        }
+    }
+}
+
+static void *worker_main(void *data) {
+    struct worker *w = data;
+    struct workers_pool *pool = w->pool;
+
+    for (;;) {
+        u32 job = deque_pop(&w->deque);
+        if (job == JOB_NONE) {
+            job = worker_steal(w);
+        }
+        if (job == JOB_NONE) {
+            break;
+        }
+
+        pool->fn(job, w->index, pool->arg);
+    }
+
+    return NULL;
+}
+
+u32 workers_cpu_count(void) {
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? count : 1;
+}
+
+void workers_run(u32 thread_count, u32 job_count, worker_job_fn fn, void *arg, struct workers_stats *stats) {
+    ASSERT(thread_count > 0, "a pool needs at least one thread\n");
+
+    struct workers_pool pool = {.count = thread_count, .fn = fn, .arg = arg};
+    pool.workers = CALLOC(thread_count, sizeof(struct worker));
+    u32 *jobs = ALLOC(sizeof(u32) * (job_count ? job_count : 1));
+    ASSERT(pool.workers && jobs, "unable to allocate a pool of %u threads\n", thread_count);
+
+    // deal the jobs out in contiguous blocks, the first job_count % thread_count
+    // blocks one job longer
+    for (u32 i = 0; i < job_count; i++) {
+        jobs[i] = i;
+    }
+
+    u32 dealt = 0;
+    for (u32 i = 0; i < thread_count; i++) {
+        struct worker *w = &pool.workers[i];
+        u32 count = job_count / thread_count + (i < job_count % thread_count);
+
+        w->pool = &pool;
+        w->index = i;
+        w->deque.jobs = &jobs[dealt];
+        atomic_init(&w->deque.top, 0);
+        atomic_init(&w->deque.bottom, count);
+        rng_seed(&w->rng, i);
+
+        dealt += count;
+    }
+
+    // the calling thread is worker 0
+    for (u32 i = 1; i < thread_count; i++) {
+        ASSERT(pthread_create(&pool.workers[i].thread, NULL, worker_main, &pool.workers[i]) == 0, "unable to start worker %u\n", i);
+    }
+    worker_main(&pool.workers[0]);
+    for (u32 i = 1; i < thread_count; i++) {
+        pthread_join(pool.workers[i].thread, NULL);
+    }
+
+    if (stats) {
+        stats->steals = 0;
+        for (u32 i = 0; i < thread_count; i++) {
+            stats->steals += pool.workers[i].steals;
+        }
+    }
+
+    free(jobs);
+    free(pool.workers);
+}
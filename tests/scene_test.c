@@ -0,0 +1,147 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/alloc.h"
+#include "../include/assets.h"
+#include "../include/game.h"
+#include "../include/macros.h"
+#include "../include/scene.h"
+
+// Steady-state frames must not allocate. Bot games with random inputs are
+// drawn frame by frame through the game's own path, scene_update looking up
+// the baked tile variants and scene_composite blending them, with no window.
+// alloc_count must not move across any frame. Frames are drawn between
+// updates too, so the settle animation is covered, and the test fails if the
+// marked, greyed or connected variants never came up.
+// usage: scene_test [dictionary.txt] [seed] [frames]
+
+#ifndef DEBUG
+#error "scene_test counts allocations, build it without -DNDEBUG"
+#endif
+
+// tiles with an opaque middle and a translucent edge, like the real ones,
+// and a translucent queue border
+static void make_assets(struct assets *a) {
+    u32 tile = TILE_SIZE * TILE_SIZE;
+    a->pixel_count = 26 * tile + 3 * TILE_SIZE * 2 * TILE_SIZE;
+    a->pixels = malloc(sizeof(u32) * a->pixel_count);
+    ASSERT(a->pixels, "unable to allocate the test sprites\n");
+
+    for (int i = 0; i < 26; i++) {
+        u32 *pixels = &a->pixels[i * tile];
+        for (u32 y = 0; y < TILE_SIZE; y++) {
+            for (u32 x = 0; x < TILE_SIZE; x++) {
+                bool edge = x < 3 || y < 3 || x >= TILE_SIZE - 3 || y >= TILE_SIZE - 3;
+                pixels[y * TILE_SIZE + x] = (edge ? 0x80000000 : 0xFF000000) | (i * 0x090503) | ((x ^ y) & 0x3F);
+            }
+        }
+        a->sprites[ASSET_TILE('A' + i)] = sprite_wrap(TILE_SIZE, TILE_SIZE, pixels);
+    }
+
+    u32 *border = &a->pixels[26 * tile];
+    for (u32 i = 0; i < 3 * TILE_SIZE * 2 * TILE_SIZE; i++) {
+        border[i] = 0x40102030;
+    }
+    a->sprites[ASSET_QUEUE_BORDER] = sprite_wrap(3 * TILE_SIZE, 2 * TILE_SIZE, border);
+}
+
+static void random_action(struct game *g, struct rng *input) {
+    switch (rng_below(input, 8)) {
+        case 0:
+            game_player_shift(g, -1);
+            break;
+        case 1:
+            game_player_shift(g, 1);
+            break;
+        case 2:
+            game_player_rotate_cw(g);
+            break;
+        case 3:
+            game_player_rotate_ccw(g);
+            break;
+        case 4:
+            game_player_flip(g);
+            break;
+        case 5:
+            game_player_drop(g, g->time);
+            break;
+        default:
+            break;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    const char *dict_file = argc > 1 ? argv[1] : "dictionary.txt";
+    u64 seed = argc > 2 ? strtoull(argv[2], NULL, 10) : 1;
+    u32 frames = argc > 3 ? strtoul(argv[3], NULL, 10) : 20000;
+
+    struct dict_trie *dict = trie_create();
+    ASSERT(trie_construct(dict, dict_file) == 0, "unable to load %s\n", dict_file);
+
+    static struct assets assets;
+    make_assets(&assets);
+
+    static struct scene scene;
+    scene_init(&scene, &assets, 10, 10);
+
+    static struct game g;
+    struct rng input;
+    rng_seed(&input, ~seed);
+    game_init(&g, dict, 10, 10, seed);
+
+    u32 games = 1;
+    u32 presented = 0;
+    u32 allocating = 0;
+    u32 variants[TILE_VARIANT_COUNT] = {0};
+
+    for (u32 frame = 0; frame < frames; frame++) {
+        // a frame every 50 ms between updates, partway through any slide
+        if (frame % 4 == 0) {
+            if (g.status == QUIT) {
+                game_destroy(&g);
+                game_init(&g, dict, 10, 10, seed + games);
+                g.gravity = games++ % 2 ? GRAVITY_SETTLE : GRAVITY_STEP;
+            }
+            if (g.status == PLAYING) {
+                random_action(&g, &input);
+            }
+            game_update(&g);
+        }
+        double clock = g.time + (frame % 4) * 50;
+
+        usize before = alloc_count;
+        if (scene_update(&scene, &g, clock)) {
+            scene_composite(&scene);
+            scene_presented(&scene);
+            presented++;
+        }
+        if (alloc_count != before) {
+            if (allocating++ < 10) {
+                fprintf(stderr, "frame %u allocated %zu times\n", frame, alloc_count - before);
+            }
+        }
+
+        for (u32 i = 0; i < scene.cols * scene.rows; i++) {
+            const struct draw_item *item = &scene.items[i];
+            for (int v = 0; v < TILE_VARIANT_COUNT && item->sprite; v++) {
+                variants[v] += item->atlas_index % TILE_VARIANT_COUNT == v;
+            }
+        }
+    }
+
+    bool covered = variants[TILE_VARIANT_MARKED] && variants[TILE_VARIANT_GREYED];
+    for (int con = CON_UP; con <= CON_RIGHT; con++) {
+        covered = covered && variants[con];
+    }
+
+    printf("scene_test: %u frames over %u games, %u presented, %u allocating, variants %s\n",
+           frames, games, presented, allocating, covered ? "covered" : "missing");
+
+    game_destroy(&g);
+    scene_destroy(&scene);
+    free(assets.pixels);
+    trie_destroy(dict);
+
+    return allocating || !covered ? 1 : 0;
+}
@@ -0,0 +1,110 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/macros.h"
+#include "../include/pixel.h"
+#include "../include/sprite.h"
+
+// Golden-image test of sprite_downscale. Each input in tests/golden is
+// downscaled by factors 1-4 on every pixel kernel instruction set the CPU has,
+// and the result, written out as a PAM file, must match the checked-in
+// expected file byte for byte. The inputs have sizes the factors don't divide
+// and translucent pixels. The expected files are plain per-channel box
+// averages, rounded down, of the whole blocks.
+// usage: sprite_test [golden directory]
+
+static const char *inputs[] = {"downscale_7x5", "downscale_13x10", "downscale_37x6"};
+
+static u32 scaled[SPRITE_MAX_W * SPRITE_MAX_H];
+
+#define PAM_HEADER "P7\nWIDTH %zu\nHEIGHT %zu\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n"
+
+static u8 *read_file(const char *path, usize *size) {
+    FILE *file = fopen(path, "rb");
+    ASSERT(file, "unable to open %s\n", path);
+
+    fseek(file, 0, SEEK_END);
+    *size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    u8 *data = malloc(*size);
+    ASSERT(data && fread(data, 1, *size, file) == *size, "unable to read %s\n", path);
+    fclose(file);
+
+    return data;
+}
+
+// the PAM file of sp, ABGR8888 pixels are R, G, B, A bytes in memory
+static u8 *write_pam(const sprite *sp, usize *size) {
+    char header[128];
+    usize header_size = snprintf(header, sizeof(header), PAM_HEADER, sp->width, sp->height);
+    usize pixel_size = sizeof(u32) * sp->width * sp->height;
+
+    *size = header_size + pixel_size;
+    u8 *data = malloc(*size);
+    ASSERT(data, "unable to allocate a %zu byte image\n", *size);
+    memcpy(data, header, header_size);
+    memcpy(data + header_size, sp->pixels, pixel_size);
+
+    return data;
+}
+
+static sprite read_pam(const char *path) {
+    usize size;
+    u8 *data = read_file(path, &size);
+
+    usize w, h;
+    int header_size = 0;
+    sscanf((char *)data, "P7\nWIDTH %zu\nHEIGHT %zu\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n%n", &w, &h, &header_size);
+    ASSERT(header_size > 0 && size == header_size + sizeof(u32) * w * h, "%s is not an RGB_ALPHA PAM file\n", path);
+
+    // copied out so the pixels are aligned
+    u32 *pixels = malloc(sizeof(u32) * w * h);
+    ASSERT(pixels, "unable to allocate %zux%zu pixels\n", w, h);
+    memcpy(pixels, data + header_size, sizeof(u32) * w * h);
+    free(data);
+
+    return sprite_wrap(w, h, pixels);
+}
+
+int main(int argc, char *argv[]) {
+    const char *dir = argc > 1 ? argv[1] : "tests/golden";
+    u32 checked = 0;
+    u32 failures = 0;
+
+    for (int isa = PIXEL_SCALAR; isa <= pixels_best_isa(); isa++) {
+        pixels_use(isa);
+
+        for (usize i = 0; i < sizeof(inputs) / sizeof(inputs[0]); i++) {
+            char path[256];
+            snprintf(path, sizeof(path), "%s/%s.pam", dir, inputs[i]);
+            sprite in = read_pam(path);
+
+            for (u32 factor = 1; factor <= 4; factor++) {
+                snprintf(path, sizeof(path), "%s/%s_by%u.pam", dir, inputs[i], factor);
+                usize expected_size;
+                u8 *expected = read_file(path, &expected_size);
+
+                sprite out = {.width = in.width / factor, .height = in.height / factor, .pixels = scaled};
+                sprite_downscale(&in, factor, &out);
+
+                usize size;
+                u8 *actual = write_pam(&out, &size);
+                if (size != expected_size || memcmp(actual, expected, size) != 0) {
+                    fprintf(stderr, "%s differs from the %s downscale of %s\n", path, pixels_isa_name(isa), inputs[i]);
+                    failures++;
+                }
+                checked++;
+
+                free(actual);
+                free(expected);
+            }
+
+            free(in.pixels);
+        }
+    }
+
+    printf("sprite_test: %u images, %u failures\n", checked, failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,131 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/macros.h"
+#include "../include/rng.h"
+#include "../include/trie.h"
+#include "../tools/trie_reference.h"
+
+// Differential test of check_substrings against the substring scan it
+// replaced. Seeded random rows of 3-16 cells, spaces mixed in and dictionary
+// words planted in some so long matches turn up, are scanned with varying
+// grid heights (the length cap) by both. The return value and every marked
+// tile must agree. Each row is scanned twice so cached lines are checked too.
+// usage: trie_test [dictionary.txt] [seed] [rows]
+
+#define ROW_MIN_LEN 3
+#define ROW_MAX_LEN 16
+
+static char **words;
+static u32 word_count;
+
+static void load_words(const char *dict_file) {
+    FILE *file = fopen(dict_file, "rb");
+    ASSERT(file, "unable to open %s\n", dict_file);
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    char *text = malloc(size + 1);
+    ASSERT(text && fread(text, 1, size, file) == (usize)size, "unable to read %s\n", dict_file);
+    text[size] = '\0';
+    fclose(file);
+
+    words = malloc(sizeof(char *) * (size / 2 + 1));
+    ASSERT(words, "unable to allocate the word list\n");
+    for (char *word = strtok(text, "\r\n"); word; word = strtok(NULL, "\r\n")) {
+        words[word_count++] = word;
+    }
+    ASSERT(word_count > 0, "%s has no words\n", dict_file);
+}
+
+// letters with a space now and then, and half the time a word written over them
+static int make_row(struct rng *r, char *row) {
+    int len = ROW_MIN_LEN + rng_below(r, ROW_MAX_LEN - ROW_MIN_LEN + 1);
+
+    for (int i = 0; i < len; i++) {
+        row[i] = rng_below(r, 6) == 0 ? ' ' : 'a' + rng_below(r, 26);
+    }
+    row[len] = '\0';
+
+    if (rng_below(r, 2) == 0) {
+        const char *word = words[rng_below(r, word_count)];
+        int word_len = strlen(word);
+        if (word_len <= len) {
+            memcpy(&row[rng_below(r, len - word_len + 1)], word, word_len);
+        }
+    }
+
+    return len;
+}
+
+static void print_marked(const char *name, bool found, const tile_t *tiles) {
+    fprintf(stderr, "  %-9s %d [", name, found);
+    for (int i = 0; i < ROW_MAX_LEN; i++) {
+        fputc(tiles[i].marked ? 'x' : '.', stderr);
+    }
+    fprintf(stderr, "]\n");
+}
+
+int main(int argc, char *argv[]) {
+    const char *dict_file = argc > 1 ? argv[1] : "dictionary.txt";
+    u64 seed = argc > 2 ? strtoull(argv[2], NULL, 10) : 1;
+    u32 rows = argc > 3 ? strtoul(argv[3], NULL, 10) : 100000;
+
+    struct dict_trie *dict = trie_create();
+    ASSERT(trie_construct(dict, dict_file) == 0, "unable to load %s\n", dict_file);
+    load_words(dict_file);
+
+    struct line_cache lines;
+    line_cache_init(&lines);
+
+    struct rng r;
+    rng_seed(&r, seed);
+
+    u32 mismatches = 0;
+    u32 found_count = 0;
+
+    for (u32 n = 0; n < rows; n++) {
+        char row[ROW_MAX_LEN + 1];
+        int len = make_row(&r, row);
+        usize grid_h = 1 + rng_below(&r, ROW_MAX_LEN + 1);
+
+        // cells map to tiles out of order, like a column does
+        u32 indices[ROW_MAX_LEN] = {0};
+        for (int i = 0; i < len; i++) {
+            u32 j = rng_below(&r, i + 1);
+            indices[i] = indices[j];
+            indices[j] = i;
+        }
+
+        tile_t expected_tiles[ROW_MAX_LEN] = {0};
+        bool expected = trie_reference_check_substrings(row, indices, expected_tiles, len, grid_h, dict);
+        found_count += expected;
+
+        for (int pass = 0; pass < 2; pass++) {
+            tile_t tiles[ROW_MAX_LEN] = {0};
+            bool found = check_substrings(row, indices, tiles, len, grid_h, dict, &lines);
+
+            bool same = found == expected;
+            for (int i = 0; i < ROW_MAX_LEN; i++) {
+                same = same && tiles[i].marked == expected_tiles[i].marked;
+            }
+
+            if (!same) {
+                if (mismatches++ < 10) {
+                    fprintf(stderr, "mismatch on \"%s\", grid height %zu, pass %d\n", row, grid_h, pass);
+                    print_marked("reference", expected, expected_tiles);
+                    print_marked("scanner", found, tiles);
+                }
+            }
+        }
+    }
+
+    printf("trie_test: %u rows, %u with words, %u mismatches\n", rows, found_count, mismatches);
+
+    line_cache_destroy(&lines);
+    trie_destroy(dict);
+    return mismatches ? 1 : 0;
+}
@@ -0,0 +1,535 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../include/assets.h"
+#include "../include/board.h"
+#include "../include/game.h"
+#include "../include/macros.h"
+#include "../include/pixel.h"
+#include "../include/rng.h"
+#include "../include/scene.h"
+#include "../include/search.h"
+#include "../include/sprite.h"
+#include "../include/trie.h"
+
+// Microbenchmarks of the dictionary, scanner, physics and compositing hot
+// paths. Each prints one "name ns_per_op ops" line, the best of
+// BENCH_REPEATS runs, so the output can be diffed and tracked across releases.
+// Inputs come from dictionary.txt and from boards of games played with seed,
+// so a run with the same arguments measures the same work.
+// usage: bench [dictionary.txt] [seed]
+
+#define BENCH_REPEATS 5
+// a run keeps going for at least this long
+#define BENCH_MIN_NS 50e6
+
+#define WORD_SET_SIZE 4096
+#define BOARD_SET_SIZE 64
+#define BOARD_SIZE 10
+
+static const char *dict_file = "dictionary.txt";
+
+static struct dict_trie *dict;
+// every scan's line cache, the benches all run on one thread
+static struct line_cache lines;
+
+// every word in dict_file, one allocation of lines
+static char *dict_text;
+static char **dict_words;
+static u32 dict_word_count;
+
+static char *random_words[WORD_SET_SIZE];
+static char *hit_words[WORD_SET_SIZE];
+static char *miss_words[WORD_SET_SIZE];
+
+// boards mid game, boards as a pair spawns on them, and boards just cleared
+// with tiles left hanging
+static struct board settled[BOARD_SET_SIZE];
+static struct board spawned[BOARD_SET_SIZE];
+static struct board cleared[BOARD_SET_SIZE];
+
+// every row and column of the settled boards as the scanner sees them
+#define ROW_COUNT (BOARD_SET_SIZE * BOARD_SIZE * 2)
+static char rows[ROW_COUNT][BOARD_SIZE + 1];
+
+// the spawn boards with a pair to place and one queued, for the search
+static struct game *positions;
+static struct search *search;
+static struct search_placement placements[SEARCH_MAX_PLACEMENTS];
+// placements of every position, what one run of the placements bench plays out
+static u32 placement_count;
+
+// pairs a bot game places per run of the bot bench, with a table for its searches
+#define BOT_TURNS 32
+#define BOT_TABLE_BITS 16
+static struct ttable bot_table;
+static u64 bot_seed;
+
+static sprite tile_sprite;
+static sprite opaque_sprite;
+static u32 screen[SCREEN_WIDTH * SCREEN_HEIGHT];
+
+// the game's own drawing path over letter tiles made like tile_sprite
+static struct assets assets;
+static struct scene scene;
+
+// results are folded in here so no work can be optimised away
+static volatile u64 sink;
+
+static double now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// call fn until BENCH_MIN_NS have passed, BENCH_REPEATS times, and report the
+// fastest run per op. Each call of fn does ops_per_call ops.
+static void bench(const char *name, void (*fn)(void), u32 ops_per_call) {
+    double best = 0;
+    u64 ops = 0;
+
+    for (int r = 0; r < BENCH_REPEATS; r++) {
+        u64 calls = 0;
+        double start = now_ns();
+        double elapsed;
+        do {
+            fn();
+            calls++;
+            elapsed = now_ns() - start;
+        } while (elapsed < BENCH_MIN_NS);
+
+        double per_op = elapsed / (calls * ops_per_call);
+        if (r == 0 || per_op < best) best = per_op;
+        ops += calls * ops_per_call;
+    }
+
+    printf("%s %.1f %llu\n", name, best, (unsigned long long)ops);
+    fflush(stdout);
+}
+
+/*
+
+ INPUTS
+
+*/
+
+static void load_words() {
+    FILE *file = fopen(dict_file, "rb");
+    ASSERT(file, "unable to open %s\n", dict_file);
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    dict_text = malloc(size + 1);
+    ASSERT(dict_text && fread(dict_text, 1, size, file) == (usize)size, "unable to read %s\n", dict_file);
+    dict_text[size] = '\0';
+    fclose(file);
+
+    u32 lines = 0;
+    for (long i = 0; i < size; i++) {
+        if (dict_text[i] == '\n') lines++;
+    }
+
+    dict_words = malloc(sizeof(char *) * (lines + 1));
+    for (char *word = strtok(dict_text, "\r\n"); word; word = strtok(NULL, "\r\n")) {
+        dict_words[dict_word_count++] = word;
+    }
+    ASSERT(dict_word_count > 0, "%s has no words\n", dict_file);
+}
+
+static char *random_string(struct rng *r, u32 min_len, u32 max_len) {
+    u32 len = min_len + rng_below(r, max_len - min_len + 1);
+    char *s = malloc(len + 1);
+    for (u32 i = 0; i < len; i++) {
+        s[i] = 'a' + rng_below(r, 26);
+    }
+    s[len] = '\0';
+    return s;
+}
+
+static void make_word_sets(u64 seed) {
+    struct rng r;
+    rng_seed(&r, seed);
+
+    for (u32 i = 0; i < WORD_SET_SIZE; i++) {
+        random_words[i] = random_string(&r, 3, BOARD_SIZE);
+        hit_words[i] = dict_words[rng_below(&r, dict_word_count)];
+
+        // a dictionary word with one letter swapped, so it shares a long
+        // prefix with real words and fails late
+        char *miss;
+        do {
+            miss = strdup(dict_words[rng_below(&r, dict_word_count)]);
+            usize len = strlen(miss);
+            miss[rng_below(&r, len)] = 'a' + rng_below(&r, 26);
+            if (!trie_search_word(dict, miss)) break;
+            free(miss);
+        } while (true);
+        miss_words[i] = miss;
+    }
+}
+
+// play random inputs into games seeded from seed on and keep boards as they go
+static void make_boards(u64 seed) {
+    struct game *g = malloc(sizeof(*g));
+    struct rng input;
+    rng_seed(&input, ~seed);
+    // picks spawns on its own, the inputs and the other boards don't depend on it
+    struct rng pick;
+    rng_seed(&pick, seed);
+
+    u32 settled_count = 0;
+    u32 spawned_count = 0;
+    u32 cleared_count = 0;
+
+    for (u64 game = 0; settled_count < BOARD_SET_SIZE || spawned_count < BOARD_SET_SIZE || cleared_count < BOARD_SET_SIZE; game++) {
+        game_init(g, dict, BOARD_SIZE, BOARD_SIZE, seed + game);
+        g->lines = &lines;
+
+        for (u32 i = 0; i < 100000 && g->status != QUIT; i++) {
+            if (g->status == PLAYING) {
+                switch (rng_below(&input, 4)) {
+                    case 0:
+                        game_player_shift(g, -1);
+                        break;
+                    case 1:
+                        game_player_shift(g, 1);
+                        break;
+                    case 2:
+                        game_player_rotate_cw(g);
+                        break;
+                    default:
+                        game_player_drop(g, g->time);
+                        break;
+                }
+            }
+
+            enum game_status before = g->status;
+            bool had_pair = g->player.active;
+            game_update(g);
+
+            // a pair just landed, keep some boards along the way
+            if ((g->events & GAME_EVENT_SET) && settled_count < BOARD_SET_SIZE && rng_below(&input, 4) == 0) {
+                settled[settled_count++] = g->board;
+            }
+            // scanned, cleared and at rest, what a search for the new pair sees
+            if (!had_pair && g->player.active && g->status == PLAYING && spawned_count < BOARD_SET_SIZE && rng_below(&pick, 4) == 0) {
+                spawned[spawned_count++] = g->board;
+            }
+            if (before == CLEARING && cleared_count < BOARD_SET_SIZE) {
+                cleared[cleared_count++] = g->board;
+            }
+            g->events = 0;
+        }
+
+        game_destroy(g);
+    }
+
+    free(g);
+
+    u32 n = 0;
+    for (u32 i = 0; i < BOARD_SET_SIZE; i++) {
+        struct board *b = &settled[i];
+        for (u32 y = 0; y < b->height; y++, n++) {
+            for (u32 x = 0; x < b->width; x++) {
+                rows[n][x] = board_filled(b, x, y) ? board_letter(b, x, y) | 0x20 : ' ';
+            }
+            rows[n][b->width] = '\0';
+        }
+        for (u32 x = 0; x < b->width; x++, n++) {
+            for (u32 y = 0; y < b->height; y++) {
+                rows[n][y] = board_filled(b, x, y) ? board_letter(b, x, y) | 0x20 : ' ';
+            }
+            rows[n][b->height] = '\0';
+        }
+    }
+}
+
+// a random pair spawned on every spawn board, with another queued
+static void make_positions(u64 seed) {
+    struct rng r;
+    rng_seed(&r, seed);
+
+    positions = calloc(BOARD_SET_SIZE, sizeof(struct game));
+    search = malloc(sizeof(*search));
+    ASSERT(positions && search, "unable to allocate the search positions\n");
+    search_init(search, dict);
+    search->lines = &lines;
+
+    for (u32 i = 0; i < BOARD_SET_SIZE; i++) {
+        struct game *g = &positions[i];
+        g->board = spawned[i];
+        g->dict = dict;
+        g->status = PLAYING;
+
+        g->player.t1.letter = 'A' + rng_below(&r, 26);
+        g->player.t2.letter = 'A' + rng_below(&r, 26);
+        g->queue[0].letter = 'A' + rng_below(&r, 26);
+        g->queue[1].letter = 'A' + rng_below(&r, 26);
+        g->player.active = game_pair_spawn(&g->board, &g->player.t1, &g->player.t2);
+
+        if (g->player.active) {
+            placement_count += search_placements(search, &g->board, g->player.t1, g->player.t2, placements, SEARCH_MAX_PLACEMENTS);
+        }
+    }
+}
+
+// tiles with an opaque middle and a soft edge, like the real ones, and a
+// fully opaque one for the copy path. The scene gets a tinted copy of the
+// tile per letter and a translucent queue border.
+static void make_sprites() {
+    tile_sprite = sprite_create(TILE_SIZE, TILE_SIZE, 0xFF3366CC);
+    for (u32 y = 0; y < TILE_SIZE; y++) {
+        for (u32 x = 0; x < TILE_SIZE; x++) {
+            u32 edge = x < 3 || y < 3 || x >= TILE_SIZE - 3 || y >= TILE_SIZE - 3;
+            if (edge) sprite_pixel_color(&tile_sprite, x, y, 0x803366CC);
+        }
+    }
+    sprite_find_opaque(&tile_sprite);
+
+    opaque_sprite = sprite_create(TILE_SIZE, TILE_SIZE, 0xFF3366CC);
+
+    u32 tile = TILE_SIZE * TILE_SIZE;
+    u32 border = 3 * TILE_SIZE * 2 * TILE_SIZE;
+    assets.pixel_count = 26 * tile + border;
+    assets.pixels = malloc(sizeof(u32) * assets.pixel_count);
+    ASSERT(assets.pixels, "unable to allocate the scene sprites\n");
+
+    for (int i = 0; i < 26; i++) {
+        u32 *pixels = &assets.pixels[i * tile];
+        for (u32 p = 0; p < tile; p++) {
+            pixels[p] = tile_sprite.pixels[p] ^ (i * 0x050709);
+        }
+        assets.sprites[ASSET_TILE('A' + i)] = sprite_wrap(TILE_SIZE, TILE_SIZE, pixels);
+    }
+    pixels_fill(&assets.pixels[26 * tile], 0x40102030, border);
+    assets.sprites[ASSET_QUEUE_BORDER] = sprite_wrap(3 * TILE_SIZE, 2 * TILE_SIZE, &assets.pixels[26 * tile]);
+
+    scene_init(&scene, &assets, BOARD_SIZE, BOARD_SIZE);
+}
+
+/*
+
+ BENCHMARKS
+
+*/
+
+static void run_trie_construct() {
+    struct dict_trie *t = trie_create();
+    ASSERT(trie_construct(t, dict_file) == 0, "unable to construct the trie from %s\n", dict_file);
+    sink += t->node_count;
+    trie_destroy(t);
+}
+
+static void search_set(char **words) {
+    u64 found = 0;
+    for (u32 i = 0; i < WORD_SET_SIZE; i++) {
+        found += trie_search_word(dict, words[i]);
+    }
+    sink += found;
+}
+
+static void run_search_random() {
+    search_set(random_words);
+}
+
+static void run_search_hit() {
+    search_set(hit_words);
+}
+
+static void run_search_miss() {
+    search_set(miss_words);
+}
+
+static void run_longest_word() {
+    int start, end;
+    for (u32 i = 0; i < ROW_COUNT; i++) {
+        sink += trie_longest_word(dict, rows[i], BOARD_SIZE, BOARD_SIZE, &start, &end);
+    }
+}
+
+static void run_check_substrings() {
+    static tile_t tiles[BOARD_SIZE];
+    static u32 indices[BOARD_SIZE] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+
+    for (u32 i = 0; i < ROW_COUNT; i++) {
+        sink += check_substrings(rows[i], indices, tiles, BOARD_SIZE, BOARD_SIZE, dict, &lines);
+    }
+}
+
+static void run_scan() {
+    for (u32 i = 0; i < BOARD_SET_SIZE; i++) {
+        struct board *b = &settled[i];
+        // only marked and the dirty masks change, so the boards can be reused
+        b->dirty_rows = b->dirty_cols = (1ull << BOARD_SIZE) - 1;
+        sink += board_scan_for_words(b, dict, &lines);
+    }
+}
+
+static void run_update_connections() {
+    for (u32 i = 0; i < BOARD_SET_SIZE; i++) {
+        sink += board_update_connections(&settled[i]);
+    }
+}
+
+static struct board scratch;
+
+static void run_board_copy() {
+    for (u32 i = 0; i < BOARD_SET_SIZE; i++) {
+        scratch = cleared[i];
+        __asm__ volatile("" : : "r"(&scratch) : "memory");
+    }
+}
+
+static void run_fall_step() {
+    for (u32 i = 0; i < BOARD_SET_SIZE; i++) {
+        scratch = cleared[i];
+        sink += board_fall_step(&scratch);
+    }
+}
+
+static void run_settle() {
+    static u8 drop[GRID_MAX_DIM * GRID_MAX_DIM];
+    for (u32 i = 0; i < BOARD_SET_SIZE; i++) {
+        scratch = cleared[i];
+        sink += board_settle(&scratch, drop);
+    }
+}
+
+static void run_search_placements() {
+    for (u32 i = 0; i < BOARD_SET_SIZE; i++) {
+        struct game *g = &positions[i];
+        if (g->player.active) {
+            sink += search_placements(search, &g->board, g->player.t1, g->player.t2, placements, SEARCH_MAX_PLACEMENTS);
+        }
+    }
+}
+
+static void run_search_best() {
+    struct search_placement best;
+    for (u32 i = 0; i < BOARD_SET_SIZE; i++) {
+        sink += search_best(search, &positions[i], &best);
+    }
+}
+
+// A bot game with a hint that follows the falling pair: search_best runs as
+// the pair spawns and again after every row it falls, then the pair is placed
+// where the last search says. The table is emptied first so every run does
+// the same work.
+static void run_search_bot() {
+    static struct game g;
+    struct search_placement best;
+    u64 seed = bot_seed;
+
+    ttable_clear(&bot_table);
+    search->table = &bot_table;
+    game_init(&g, dict, BOARD_SIZE, BOARD_SIZE, seed);
+    g.lines = &lines;
+
+    for (u32 turn = 0; turn < BOT_TURNS;) {
+        if (g.status == QUIT) {
+            game_destroy(&g);
+            game_init(&g, dict, BOARD_SIZE, BOARD_SIZE, ++seed);
+            g.lines = &lines;
+        }
+
+        if (g.status == PLAYING && search_best(search, &g, &best)) {
+            while (game_player_can_move(&g, (vec2i){0, 1})) {
+                game_player_drop(&g, g.time);
+                search_best(search, &g, &best);
+            }
+
+            g.player.t1 = best.t1;
+            g.player.t2 = best.t2;
+            game_player_drop(&g, g.time);
+            turn++;
+        }
+        game_update(&g);
+    }
+
+    game_destroy(&g);
+    search->table = NULL;
+}
+
+static void run_blit_tile() {
+    struct blit_target target = {.pixels = screen, .width = SCREEN_WIDTH, .height = SCREEN_HEIGHT, .stride = SCREEN_WIDTH};
+    sprite_blit(&tile_sprite, 100, 100, target, BLIT_PLAIN, BLIT_NO_TINT);
+    __asm__ volatile("" : : "r"(screen) : "memory");
+}
+
+static void run_blit_tile_opaque() {
+    struct blit_target target = {.pixels = screen, .width = SCREEN_WIDTH, .height = SCREEN_HEIGHT, .stride = SCREEN_WIDTH};
+    sprite_blit(&opaque_sprite, 100, 100, target, BLIT_PLAIN, BLIT_NO_TINT);
+    __asm__ volatile("" : : "r"(screen) : "memory");
+}
+
+// the software renderer going from one position to the next: draw list,
+// tile variants, damage, and recompositing what changed
+static void run_render_frame() {
+    static u32 frame;
+    struct game *g = &positions[frame++ % BOARD_SET_SIZE];
+
+    if (scene_update(&scene, g, g->time)) {
+        scene_composite(&scene);
+        scene_presented(&scene);
+    }
+    __asm__ volatile("" : : "r"(scene.screen) : "memory");
+}
+
+// the same with the whole screen recomposited, background and grid included
+static void run_render_frame_full() {
+    static u32 frame;
+    struct game *g = &positions[frame++ % BOARD_SET_SIZE];
+
+    scene.full = true;
+    scene_update(&scene, g, g->time);
+    scene_composite(&scene);
+    scene_presented(&scene);
+    __asm__ volatile("" : : "r"(scene.screen) : "memory");
+}
+
+int main(int argc, char *argv[]) {
+    if (argc > 1) dict_file = argv[1];
+    u64 seed = argc > 2 ? strtoull(argv[2], NULL, 10) : 1;
+
+    dict = trie_create();
+    ASSERT(trie_construct(dict, dict_file) == 0, "unable to load %s\n", dict_file);
+    line_cache_init(&lines);
+
+    load_words();
+    make_word_sets(seed);
+    make_boards(seed);
+    make_positions(seed);
+    ttable_init(&bot_table, BOT_TABLE_BITS);
+    bot_seed = seed;
+    make_sprites();
+
+    printf("bench ns_per_op ops\n");
+
+    bench("trie_construct", run_trie_construct, 1);
+    bench("trie_search_word_random", run_search_random, WORD_SET_SIZE);
+    bench("trie_search_word_hit", run_search_hit, WORD_SET_SIZE);
+    bench("trie_search_word_miss", run_search_miss, WORD_SET_SIZE);
+    bench("trie_longest_word_row", run_longest_word, ROW_COUNT);
+    bench("check_substrings_row", run_check_substrings, ROW_COUNT);
+    bench("board_scan_for_words", run_scan, BOARD_SET_SIZE);
+    bench("board_update_connections", run_update_connections, BOARD_SET_SIZE);
+    // the physics benches copy the board first, subtract this
+    bench("board_copy", run_board_copy, BOARD_SET_SIZE);
+    bench("board_fall_step", run_fall_step, BOARD_SET_SIZE);
+    bench("board_settle", run_settle, BOARD_SET_SIZE);
+    // per placement played out, and per position with the lookahead
+    bench("search_placements", run_search_placements, placement_count);
+    bench("search_best", run_search_best, BOARD_SET_SIZE);
+    bench("search_bot_turn", run_search_bot, BOT_TURNS);
+    LOG("search_bot_turn table hit rate %.3f", ttable_hit_rate(&bot_table));
+    bench("blit_tile", run_blit_tile, 1);
+    bench("blit_tile_opaque", run_blit_tile_opaque, 1);
+    bench("render_frame", run_render_frame, 1);
+    bench("render_frame_full", run_render_frame_full, 1);
+
+    return 0;
+}
@@ -0,0 +1,22 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../include/macros.h"
+#include "../include/trie.h"
+
+// Compile a word list into the dictionary image the game maps at startup.
+// usage: dict_compile [dictionary.txt] [dictionary.bin]
+int main(int argc, char *argv[]) {
+    const char *dict_file = argc > 1 ? argv[1] : "dictionary.txt";
+    const char *image_file = argc > 2 ? argv[2] : "dictionary.bin";
+
+    struct dict_trie *dict = trie_create();
+    trie_construct(dict, dict_file);
+
+    ASSERT(trie_write_image(dict, image_file, dict_file) == 0, "unable to write dictionary image %s\n", image_file);
+    LOG("Wrote %s (%u nodes)", image_file, dict->node_count);
+
+    trie_destroy(dict);
+
+    return 0;
+}
@@ -0,0 +1,115 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../include/game.h"
+#include "../include/macros.h"
+
+// Play games with random inputs and no window, straight through game_update.
+// usage: headless [games] [max updates per game] [seed]
+// Game i is seeded with seed + i and its inputs are drawn from its own stream,
+// so a run with the same arguments is reproduced exactly.
+
+struct stats {
+    u64 games;
+    u64 updates;
+    u64 landed;
+    u64 clears;
+    u64 cleared_tiles;
+};
+
+static void random_action(struct game *g, struct rng *input) {
+    switch (rng_below(input, 8)) {
+        case 0:
+            game_player_shift(g, -1);
+            break;
+        case 1:
+            game_player_shift(g, 1);
+            break;
+        case 2:
+            game_player_rotate_cw(g);
+            break;
+        case 3:
+            game_player_rotate_ccw(g);
+            break;
+        case 4:
+            game_player_flip(g);
+            break;
+        case 5:
+            game_player_drop(g, g->time);
+            break;
+        default:
+            break;
+    }
+}
+
+static void play_game(struct game *g, struct dict_trie *dict, struct line_cache *lines, u64 seed, u64 max_updates,
+                      struct stats *stats) {
+    struct rng input;
+    rng_seed(&input, ~seed);
+
+    game_init(g, dict, 10, 10, seed);
+    g->lines = lines;
+
+    for (u64 i = 0; i < max_updates && g->status != QUIT; i++) {
+        if (g->status == PLAYING) {
+            random_action(g, &input);
+        }
+
+        if (g->status == CLEARING) {
+            stats->clears++;
+            for (u32 y = 0; y < g->board.height; y++) {
+                stats->cleared_tiles += __builtin_popcountll(g->board.marked[y]);
+            }
+        }
+
+        game_update(g);
+        stats->updates++;
+
+        if (g->events & GAME_EVENT_SET) {
+            stats->landed++;
+        }
+        g->events = 0;
+    }
+
+    game_destroy(g);
+    stats->games++;
+}
+
+int main(int argc, char *argv[]) {
+    u64 games = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000;
+    u64 max_updates = argc > 2 ? strtoull(argv[2], NULL, 10) : 100000;
+
+    u64 seed = argc > 3 ? strtoull(argv[3], NULL, 10) : (u64)time(NULL);
+
+    struct dict_trie *dict = trie_create();
+    ASSERT(trie_load(dict, "./dictionary.bin", "./dictionary.txt") == 0, "unable to load the dictionary\n");
+
+    // struct game holds the whole board, keep it off the stack
+    struct game *g = malloc(sizeof(*g));
+    struct stats stats = {0};
+    struct line_cache lines;
+    line_cache_init(&lines);
+
+    clock_t begin = clock();
+    for (u64 i = 0; i < games; i++) {
+        play_game(g, dict, &lines, seed + i, max_updates, &stats);
+    }
+    double seconds = (double)(clock() - begin) / CLOCKS_PER_SEC;
+
+    printf("seed %llu\n", (unsigned long long)seed);
+    printf("games %llu\n", (unsigned long long)stats.games);
+    printf("updates %llu\n", (unsigned long long)stats.updates);
+    printf("pairs_landed %llu\n", (unsigned long long)stats.landed);
+    printf("clears %llu\n", (unsigned long long)stats.clears);
+    printf("tiles_cleared %llu\n", (unsigned long long)stats.cleared_tiles);
+    printf("seconds %.3f\n", seconds);
+    printf("updates_per_second %.0f\n", seconds > 0 ? stats.updates / seconds : 0.0);
+    printf("line_cache_hit_rate %.3f\n", line_cache_hit_rate(&lines));
+
+    free(g);
+    line_cache_destroy(&lines);
+    trie_destroy(dict);
+
+    return 0;
+}
@@ -0,0 +1,93 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../include/macros.h"
+#include "../include/pixel.h"
+
+// Time every pixel kernel on every instruction set the CPU has and print
+// pixels/ns, after checking each one matches the scalar output bit for bit.
+// usage: pixel_bench [pixels per pass] [passes]
+
+enum { FILL, GREYSCALE, LIGHTEN, DARKEN, HALVE_ROWS, KERNEL_COUNT };
+
+static const char *kernel_names[KERNEL_COUNT] = {"fill", "greyscale", "lighten", "darken", "halve_rows"};
+
+static double now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// run kernel k once over count output pixels
+static void run(int k, u32 *dst, const u32 *src, usize count) {
+    switch (k) {
+        case FILL:
+            pixels_fill(dst, 0xCCCCDDFF, count);
+            break;
+        case GREYSCALE:
+            pixels_greyscale(dst, src, count);
+            break;
+        case LIGHTEN:
+            pixels_lighten(dst, src, count);
+            break;
+        case DARKEN:
+            pixels_darken(dst, src, count);
+            break;
+        case HALVE_ROWS:
+            // source rows are twice as long as the output
+            pixels_halve_rows(dst, src, src + 2 * count, count);
+            break;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    usize count = argc > 1 ? strtoull(argv[1], NULL, 10) : 4096;
+    int passes = argc > 2 ? atoi(argv[2]) : 20000;
+
+    // halve_rows reads two source rows of 2 * count pixels
+    u32 *src = malloc(sizeof(u32) * count * 4);
+    u32 *dst = malloc(sizeof(u32) * count);
+    u32 *expect = malloc(sizeof(u32) * count);
+
+    u32 x = 0x12345678;
+    for (usize i = 0; i < count * 4; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        src[i] = x;
+    }
+
+    enum pixel_isa best = pixels_best_isa();
+
+    printf("kernel isa pixels_per_ns\n");
+    for (int k = 0; k < KERNEL_COUNT; k++) {
+        pixels_use(PIXEL_SCALAR);
+        run(k, expect, src, count);
+
+        for (enum pixel_isa isa = PIXEL_SCALAR; isa <= best; isa++) {
+            pixels_use(isa);
+
+            memset(dst, 0, sizeof(u32) * count);
+            run(k, dst, src, count);
+            ASSERT(memcmp(dst, expect, sizeof(u32) * count) == 0, "%s %s differs from scalar\n", kernel_names[k], pixels_isa_name(isa));
+
+            double start = now_ns();
+            for (int p = 0; p < passes; p++) {
+                run(k, dst, src, count);
+                // keep the compiler from dropping repeated passes
+                __asm__ volatile("" : : "r"(dst) : "memory");
+            }
+            double elapsed = now_ns() - start;
+
+            printf("%s %s %.3f\n", kernel_names[k], pixels_isa_name(isa), (double)count * passes / elapsed);
+        }
+    }
+
+    free(src);
+    free(dst);
+    free(expect);
+
+    return 0;
+}
@@ -0,0 +1,22 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../include/assets.h"
+#include "../include/macros.h"
+
+// Decode the images in gfx/ and pack them into the sprite sheet the game maps
+// at startup.
+// usage: sheet_pack [sprites.bin]
+int main(int argc, char *argv[]) {
+    const char *sheet_file = argc > 1 ? argv[1] : "sprites.bin";
+
+    struct assets assets = {0};
+    ASSERT(assets_decode(&assets) == 0, "unable to decode the images in gfx/\n");
+
+    ASSERT(assets_write_sheet(&assets, sheet_file) == 0, "unable to write sprite sheet %s\n", sheet_file);
+    LOG("Wrote %s (%u pixels)", sheet_file, assets.pixel_count);
+
+    assets_destroy(&assets);
+
+    return 0;
+}
@@ -0,0 +1,261 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "../include/alloc.h"
+#include "../include/game.h"
+#include "../include/macros.h"
+#include "../include/workers.h"
+
+// Play many bot games across every core and collect their statistics, for
+// tuning the letter weights and grey tiles. Games are grouped into shards of
+// SHARD_GAMES, run as jobs on the work-stealing pool. Each finished shard's
+// histograms are appended to the output as a line of JSON, so a long run can
+// be watched or cut short. The totals are printed at the end.
+// usage: simulate [games] [seed] [threads] [output]
+// Game i is seeded with seed + i and plays the same inputs whichever thread
+// runs it, so the same games and seed give the same histograms.
+
+#define SHARD_GAMES 256
+#define MAX_UPDATES 100000
+
+#define HIST_BINS 64
+// pairs landed per bin of the game length histogram
+#define LENGTH_BIN 10
+
+struct histograms {
+    u64 games;
+    // games that ended because the next pair had no room to spawn
+    u64 blocked;
+    // pairs landed, LENGTH_BIN per bin, the last bin is open ended
+    u64 length[HIST_BINS];
+    // words cleared per game, the last bin is open ended
+    u64 words[HIST_BINS];
+    // letters per cleared word
+    u64 word_length[GRID_MAX_DIM + 1];
+};
+
+// everything a thread uses, reset between shards
+struct worker_state {
+    struct arena arena;
+    struct rng input;
+    struct line_cache lines;
+};
+
+struct run {
+    u64 games;
+    u64 seed;
+    u32 shards;
+
+    struct worker_state *states;
+    struct dict_trie *dict; // shared, read only
+
+    pthread_mutex_t lock;
+    struct histograms total;
+    FILE *output;
+};
+
+static void hist_add(u64 *bins, u32 count, u64 value) {
+    bins[value < count ? value : count - 1]++;
+}
+
+static void random_action(struct game *g, struct rng *input) {
+    switch (rng_below(input, 8)) {
+        case 0:
+            game_player_shift(g, -1);
+            break;
+        case 1:
+            game_player_shift(g, 1);
+            break;
+        case 2:
+            game_player_rotate_cw(g);
+            break;
+        case 3:
+            game_player_rotate_ccw(g);
+            break;
+        case 4:
+            game_player_flip(g);
+            break;
+        case 5:
+            game_player_drop(g, g->time);
+            break;
+        default:
+            break;
+    }
+}
+
+static void play_game(struct game *g, struct worker_state *ws, struct dict_trie *dict, u64 seed, struct histograms *h) {
+    rng_seed(&ws->input, ~seed);
+    game_init(g, dict, 10, 10, seed);
+    g->lines = &ws->lines;
+
+    u64 landed = 0;
+    u64 words = 0;
+
+    for (u64 i = 0; i < MAX_UPDATES && g->status != QUIT; i++) {
+        if (g->status == PLAYING) {
+            random_action(g, &ws->input);
+        }
+
+        game_update(g);
+
+        // the scan that just found words left their lengths on the board
+        if (g->status == CLEARING) {
+            for (u32 w = 0; w < g->board.found_count; w++) {
+                hist_add(h->word_length, GRID_MAX_DIM + 1, g->board.found[w]);
+            }
+            words += g->board.found_count;
+        }
+
+        if (g->events & GAME_EVENT_SET) {
+            landed++;
+        }
+        g->events = 0;
+    }
+
+    h->games++;
+    h->blocked += g->status == QUIT;
+    hist_add(h->length, HIST_BINS, landed / LENGTH_BIN);
+    hist_add(h->words, HIST_BINS, words);
+
+    game_destroy(g);
+}
+
+static void hist_merge(struct histograms *into, const struct histograms *h) {
+    into->games += h->games;
+    into->blocked += h->blocked;
+    for (int i = 0; i < HIST_BINS; i++) {
+        into->length[i] += h->length[i];
+        into->words[i] += h->words[i];
+    }
+    for (int i = 0; i <= GRID_MAX_DIM; i++) {
+        into->word_length[i] += h->word_length[i];
+    }
+}
+
+static void write_bins(FILE *file, const char *name, const u64 *bins, u32 count) {
+    fprintf(file, ",\"%s\":[", name);
+    for (u32 i = 0; i < count; i++) {
+        fprintf(file, i ? ",%llu" : "%llu", (unsigned long long)bins[i]);
+    }
+    fputc(']', file);
+}
+
+static void write_shard(FILE *file, u32 shard, const struct histograms *h) {
+    fprintf(file, "{\"shard\":%u,\"games\":%llu,\"blocked\":%llu", shard, (unsigned long long)h->games, (unsigned long long)h->blocked);
+    write_bins(file, "length", h->length, HIST_BINS);
+    write_bins(file, "words", h->words, HIST_BINS);
+    write_bins(file, "word_length", h->word_length, GRID_MAX_DIM + 1);
+    fputs("}\n", file);
+    fflush(file);
+}
+
+static void run_shard(u32 shard, u32 worker, void *arg) {
+    struct run *run = arg;
+    struct worker_state *ws = &run->states[worker];
+
+    arena_reset(&ws->arena);
+    struct game *g = arena_alloc(&ws->arena, sizeof(*g));
+    struct histograms *h = arena_alloc(&ws->arena, sizeof(*h));
+    ASSERT(g && h, "worker %u's arena is too small\n", worker);
+    memset(h, 0, sizeof(*h));
+
+    u64 first = (u64)shard * SHARD_GAMES;
+    u64 last = first + SHARD_GAMES < run->games ? first + SHARD_GAMES : run->games;
+    for (u64 i = first; i < last; i++) {
+        play_game(g, ws, run->dict, run->seed + i, h);
+    }
+
+    pthread_mutex_lock(&run->lock);
+    hist_merge(&run->total, h);
+    write_shard(run->output, shard, h);
+    pthread_mutex_unlock(&run->lock);
+}
+
+// mean of a histogram whose bin i stands for i * scale
+static double hist_mean(const u64 *bins, u32 count, double scale) {
+    double sum = 0;
+    u64 n = 0;
+    for (u32 i = 0; i < count; i++) {
+        sum += (double)bins[i] * i * scale;
+        n += bins[i];
+    }
+    return n ? sum / n : 0;
+}
+
+static double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[]) {
+    struct run run = {0};
+    run.games = argc > 1 ? strtoull(argv[1], NULL, 10) : 100000;
+    run.seed = argc > 2 ? strtoull(argv[2], NULL, 10) : (u64)time(NULL);
+    u32 threads = argc > 3 && atoi(argv[3]) > 0 ? atoi(argv[3]) : workers_cpu_count();
+    const char *output = argc > 4 ? argv[4] : "simulate.jsonl";
+
+    run.shards = (run.games + SHARD_GAMES - 1) / SHARD_GAMES;
+
+    run.dict = trie_create();
+    ASSERT(trie_load(run.dict, "./dictionary.bin", "./dictionary.txt") == 0, "unable to load the dictionary\n");
+
+    run.output = fopen(output, "w");
+    ASSERT(run.output, "unable to create %s\n", output);
+    pthread_mutex_init(&run.lock, NULL);
+
+    run.states = CALLOC(threads, sizeof(struct worker_state));
+    ASSERT(run.states, "unable to allocate %u workers\n", threads);
+    for (u32 i = 0; i < threads; i++) {
+        // a game and a shard's histograms, with room for alignment
+        arena_init(&run.states[i].arena, sizeof(struct game) + sizeof(struct histograms) + 2 * ARENA_ALIGN);
+        ASSERT(run.states[i].arena.base, "unable to allocate worker %u's arena\n", i);
+        line_cache_init(&run.states[i].lines);
+    }
+
+    struct workers_stats stats;
+    double begin = now_seconds();
+    workers_run(threads, run.shards, run_shard, &run, &stats);
+    double seconds = now_seconds() - begin;
+
+    struct histograms *t = &run.total;
+    u64 words = 0;
+    for (int i = 0; i <= GRID_MAX_DIM; i++) {
+        words += t->word_length[i];
+    }
+
+    // every worker's line cache, counted together
+    struct line_cache lines = {0};
+    for (u32 i = 0; i < threads; i++) {
+        lines.hits += run.states[i].lines.hits;
+        lines.misses += run.states[i].lines.misses;
+    }
+
+    printf("seed %llu\n", (unsigned long long)run.seed);
+    printf("games %llu\n", (unsigned long long)t->games);
+    printf("threads %u\n", threads);
+    printf("shards %u\n", run.shards);
+    printf("steals %llu\n", (unsigned long long)stats.steals);
+    printf("blocked_rate %.4f\n", t->games ? (double)t->blocked / t->games : 0.0);
+    printf("mean_pairs_landed %.1f\n", hist_mean(t->length, HIST_BINS, LENGTH_BIN));
+    printf("mean_words_cleared %.2f\n", hist_mean(t->words, HIST_BINS, 1));
+    printf("words_cleared %llu\n", (unsigned long long)words);
+    printf("mean_word_length %.2f\n", hist_mean(t->word_length, GRID_MAX_DIM + 1, 1));
+    printf("seconds %.3f\n", seconds);
+    printf("games_per_second %.0f\n", seconds > 0 ? t->games / seconds : 0.0);
+    printf("line_cache_hit_rate %.3f\n", line_cache_hit_rate(&lines));
+
+    fclose(run.output);
+    pthread_mutex_destroy(&run.lock);
+    for (u32 i = 0; i < threads; i++) {
+        arena_destroy(&run.states[i].arena);
+        line_cache_destroy(&run.states[i].lines);
+    }
+    free(run.states);
+    trie_destroy(run.dict);
+
+    return 0;
+}
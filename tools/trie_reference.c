@@ -0,0 +1,42 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "trie_reference.h"
+
+bool trie_reference_check_substrings(const char *str, u32 *indices, tile_t *tiles, usize grid_w, usize grid_h, struct dict_trie *dict) {
+    int len = strlen(str);
+    int max_len = len < grid_h ? len : grid_h;
+
+    int longest = 0;
+    int index_start = -1;
+    int index_end = -1;
+
+    bool found = false;
+
+    for (int sub_len = max_len; sub_len >= 3; sub_len--) {
+        for (int i = 0; i <= len - sub_len; i++) {
+            char substr[sub_len + 1];
+            strncpy(substr, str + i, sub_len);
+            substr[sub_len] = '\0';
+
+            if (check_word_viability(substr) && check_string_validity(substr)) {
+                if (trie_search_word(dict, substr)) {
+                    if (sub_len > longest) {
+                        longest = sub_len;
+                        index_start = i;
+                        index_end = i + sub_len;
+                        found = true;
+                    }
+
+                    break;
+                }
+            }
+        }
+    }
+
+    for (int x = index_start; x < index_end; x++) {
+        tiles[indices[x]].marked = true;
+    }
+
+    return found;
+}
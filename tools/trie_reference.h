@@ -0,0 +1,9 @@
+#pragma once
+#include "../include/tile.h"
+#include "../include/trie.h"
+#include "../include/types.h"
+
+// check_substrings as it was before the single-pass scan: every substring from
+// the longest down is copied out and looked up from the root. Slow, but plain
+// enough to trust, so the tests hold the real scanner to its results.
+bool trie_reference_check_substrings(const char *str, u32 *indices, tile_t *tiles, usize grid_w, usize grid_h, struct dict_trie *dict);